@@ -1,181 +1,85 @@
 #include "Wiegand.h"
+#if defined(WIEGAND_SLEEP) && defined(__AVR__)
+	#include <avr/sleep.h>
+#endif
 
-// port to interrupt mapping is different for different boards
-// mapping ports other than these results in init failure
-// Board			int0	int1	int2	int3	int4	int5	
-// Uno, Ethernet	2		3         
-// Mega2560			2		3		21		20		19		18	
-// Leonardo			3		2		0		1		7			
-// Please note that Arduino interruptt numbers don't allways corespond with Atmel numbers
-// i.e. Leonard INT4 is mapped to 32U4 INT6, which means that indexes used with attachInterrupt
-// are different from those used for direct register manipulation
-// for more info check http://www.gammon.com.au/images/Arduino/attachInterruptPinMappings.png
-bool Wiegand::attachInterrupts(const byte pin, bool meaning)
-{
-	switch(pin)
-	{
-#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
-		case 2:
-			if (_int0_instance == NULL)
-				_int0_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(0, isr0_high, FALLING);
-			else
-				attachInterrupt(0, isr0_low, FALLING);
-			bitSet(EIFR, INTF0);
-			break;
-		case 3:
-			if (_int1_instance == NULL)
-				_int1_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(1, isr1_high, FALLING);
-			else
-				attachInterrupt(1, isr1_low, FALLING);
-			bitSet(EIFR, INTF1);
-			break;
-#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-		case 2:
-			if (_int0_instance == NULL)
-				_int0_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(0, isr0_high, FALLING);
-			else
-				attachInterrupt(0, isr0_low, FALLING);
-			bitSet(EIFR, INTF4);
-			break;
-		case 3:
-			if (_int1_instance == NULL)
-				_int1_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(1, isr1_high, FALLING);
-			else
-				attachInterrupt(1, isr1_low, FALLING);
-			bitSet(EIFR, INTF5);
-			break;
-		case 21:
-			if (_int2_instance == NULL)
-				_int2_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(2, isr2_high, FALLING);
-			else
-				attachInterrupt(2, isr2_low, FALLING);
-			bitSet(EIFR, INTF0);
-			break;
-		case 20:
-			if (_int3_instance == NULL)
-				_int3_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(3, isr3_high, FALLING);
-			else
-				attachInterrupt(3, isr3_low, FALLING);
-			bitSet(EIFR, INTF1);
-			break;
-		case 19:
-			if (_int4_instance == NULL)
-				_int4_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(4, isr4_high, FALLING);
-			else
-				attachInterrupt(4, isr4_low, FALLING);
-			bitSet(EIFR, INTF2);
-			break;
-		case 18:
-			if (_int5_instance == NULL)
-				_int5_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(5, isr5_high, FALLING);
-			else
-				attachInterrupt(5, isr5_low, FALLING);
-			bitSet(EIFR, INTF3);
-			break;
-#elif defined (__AVR_ATmega32U4__)
-		case 3:
-			if (_int0_instance == NULL)
-				_int0_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(0, isr0_high, FALLING);
-			else
-				attachInterrupt(0, isr0_low, FALLING);
-			bitSet(EIFR, INTF0);
-			break;
-		case 2:
-			if (_int1_instance == NULL)
-				_int1_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(1, isr1_high, FALLING);
-			else
-				attachInterrupt(1, isr1_low, FALLING);
-			bitSet(EIFR, INTF1);
-			break;
-		case 0:
-			if (_int2_instance == NULL)
-				_int2_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(2, isr2_high, FALLING);
-			else
-				attachInterrupt(2, isr2_low, FALLING);
-			bitSet(EIFR, INTF2);
-			break;
-		case 1:
-			if (_int3_instance == NULL)
-				_int3_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(3, isr3_high, FALLING);
-			else
-				attachInterrupt(3, isr3_low, FALLING);
-			bitSet(EIFR, INTF3);
-			break;
-		case 7:
-			if (_int4_instance == NULL)
-				_int4_instance = this;
-			else
-				return false;				
-			if (meaning)
-				attachInterrupt(4, isr4_high, FALLING);
-			else
-				attachInterrupt(4, isr4_low, FALLING);
-			bitSet(EIFR, INTF6);
-			break;
+#if (WIEGAND_QUEUE_SIZE & (WIEGAND_QUEUE_SIZE - 1)) != 0 || WIEGAND_QUEUE_SIZE > 64
+	#error WIEGAND_QUEUE_SIZE must be a power of two and not more than 64
+#endif
+
+#if defined(WIEGAND_CAPTURE) && ((WIEGAND_CAPTURE & (WIEGAND_CAPTURE - 1)) != 0 || WIEGAND_CAPTURE > 128)
+	#error WIEGAND_CAPTURE must be a power of two and not more than 128
+#endif
+
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	#if !defined(WIEGAND_HAL_AVR) && !defined(WIEGAND_HAL_HOST)
+		#error WIEGAND_TIMER1_TIMESTAMPS is supported only on AVR boards
+	#endif
+	#if F_CPU % 8000000UL != 0
+		#error WIEGAND_TIMER1_TIMESTAMPS needs F_CPU to be a multiple of 8MHz
+	#endif
+
+	// Timer1 runs with prescaler 8, so it counts 1 (8MHz) or 2 (16MHz) ticks per microsecond
+	#define WIEGAND_TIMER1_TICKS (F_CPU / 8000000UL)
+	#define WIEGAND_TIMER1_PERIOD (65536UL / WIEGAND_TIMER1_TICKS)
+#endif
+
+// statistics counters compile to nothing when WIEGAND_STATS is not defined
+#if defined(WIEGAND_STATS)
+	#define WIEGAND_COUNT(counter) _stats.counter++
+#else
+	#define WIEGAND_COUNT(counter)
+#endif
+
+// shortest interval between bits which is learned, Wiegand readers don't send bits closer than 200us
+#if defined(WIEGAND_MIN_BIT_INTERVAL) && WIEGAND_MIN_BIT_INTERVAL > 200
+	#define WIEGAND_ADAPTIVE_MIN_INTERVAL WIEGAND_MIN_BIT_INTERVAL
+#else
+	#define WIEGAND_ADAPTIVE_MIN_INTERVAL 200
 #endif
-		default:
-			return false;
-	}
-	return true;
-}
 
 // constructor
 // low_int_pin is number of pin connected to DATA0
 // high_int_pin is number of pin connected to DATA1
-Wiegand::Wiegand(const byte low_int_pin, const byte high_int_pin)
-	:_low_int_pin(low_int_pin), _high_int_pin(high_int_pin), _status(Uninitialized) {}
+// max_bits is message capacity, storage holds buffers of (WIEGAND_QUEUE_SIZE + 2) such messages
+WiegandReceiver::WiegandReceiver(const byte low_int_pin, const byte high_int_pin,
+	const uint8_t max_bits, uint8_t * storage)
+	:_low_int_pin(low_int_pin), _high_int_pin(high_int_pin), _max_bits(max_bits), _status(Uninitialized),
+	_pin_change(false), _queue_head(0), _queue_tail(0), _seq(0), _errors(0), _errors_seen(0),
+	_next_instance(NULL), _on_message(NULL), _on_error(NULL), status(Uninitialized), bit_count(0),
+	rcv_buffer(storage)
+{
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	// learning starts from the longest timeout, so no single interval sets it
+	_bit_interval = WIEGAND_MAX_BIT_INTERVAL / WIEGAND_ADAPTIVE_TIMEOUT;
+	_expected_bits = 0;
+#endif
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	WiegandHal::input(low_int_pin, _low_input);
+	WiegandHal::input(high_int_pin, _high_input);
+#endif
+#if defined(WIEGAND_REPEAT_WINDOW)
+	memset(_repeats, 0, sizeof(_repeats));
+#endif
+#if defined(WIEGAND_CAPTURE)
+	_capture_head = 0;
+	_capture_tail = 0;
+#endif
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	_edge_micros = 0;
+	_edge_ticks = 0;
+	_edge_rest = 0;
+	_edge_epoch = 0;
+#endif
+#if defined(WIEGAND_STATS)
+	memset(&_stats, 0, sizeof(_stats));
+#endif
+}
 
 // initializer
+// mode selects whether pins use external interrupts or pin change interrupts
 // returns true if successfull, false otherwise
-bool Wiegand::begin()
+bool WiegandReceiver::begin(WiegandInterrupts mode)
 {
 	
 	// if instance is already initialized return false
@@ -184,29 +88,46 @@ bool Wiegand::begin()
 		return false;
 	}
 
-	// Arduino seems to ignore Atmel datasheet regarding correct way to attach external interrupts
-	// and triggers ISR on attacnh, so we clear interrupt flag manually after attaching interrupts
-	// also, somewhere was mentioned that attaching interrupts to static class members should be atomic
+	// somewhere was mentioned that attaching interrupts to static class members should be atomic
 	noInterrupts();
 	
 	// set ports as inputs
 	pinMode(_low_int_pin, INPUT);
 	pinMode(_high_int_pin, INPUT);
 
-	// attach ISRs depending on target board
-	if (!attachInterrupts(_low_int_pin, LOW))
-	{	
-		_status = Error;
-		return false;
+	// attach ISRs through pin change table or edge source of target board (see WiegandHal.h)
+	// if the second pin fails, the first one is released, so instance stays uninitialized
+	// and nothing of it is left live
+	bool attached;
+	_pin_change = (mode == PinChangeInterrupts);
+	if (_pin_change)
+	{
+		attached = attachPinChange(_low_int_pin, LOW);
+		if (attached && !attachPinChange(_high_int_pin, HIGH))
+		{
+			detachPinChange(_low_int_pin);
+			attached = false;
+		}
 	}
-	if (!attachInterrupts(_high_int_pin, HIGH))
-	{	
-		_status = Error;
+	else
+	{
+		attached = WiegandHal::attach(_low_int_pin, this, LOW);
+		if (attached && !WiegandHal::attach(_high_int_pin, this, HIGH))
+		{
+			WiegandHal::detach(_low_int_pin);
+			attached = false;
+		}
+	}
+
+	if (!attached)
+	{
+		interrupts();
 		return false;
 	}
 
 	// mark the instance as initialized
-	_status = Idle;
+	resetMessage();
+	addInstance();
 
 	// clear internal state
 	// but don't disable/enable interrupts internally
@@ -217,30 +138,191 @@ bool Wiegand::begin()
 	return true;
 }
 
-// ISR glue routines
-void Wiegand::isr0_low () {_int0_instance->readBit(LOW);}
-void Wiegand::isr1_low () {_int1_instance->readBit(LOW);}
-void Wiegand::isr2_low () {_int2_instance->readBit(LOW);}
-void Wiegand::isr3_low () {_int3_instance->readBit(LOW);}
-void Wiegand::isr4_low () {_int4_instance->readBit(LOW);}
-void Wiegand::isr5_low () {_int5_instance->readBit(LOW);}
-void Wiegand::isr0_high () {_int0_instance->readBit(HIGH);}
-void Wiegand::isr1_high () {_int1_instance->readBit(HIGH);}
-void Wiegand::isr2_high () {_int2_instance->readBit(HIGH);}
-void Wiegand::isr3_high () {_int3_instance->readBit(HIGH);}
-void Wiegand::isr4_high () {_int4_instance->readBit(HIGH);}
-void Wiegand::isr5_high () {_int5_instance->readBit(HIGH);}
-
-// for use by ISR glue routines
-Wiegand * Wiegand::_int0_instance;
-Wiegand * Wiegand::_int1_instance;
-Wiegand * Wiegand::_int2_instance;
-Wiegand * Wiegand::_int3_instance;
-Wiegand * Wiegand::_int4_instance;
-Wiegand * Wiegand::_int5_instance;
+#if defined(WIEGAND_PCINT)
+
+#if defined(PCINT2_vect)
+	#define WIEGAND_PCINT_GROUPS 3
+#elif defined(PCINT1_vect)
+	#define WIEGAND_PCINT_GROUPS 2
+#else
+	#define WIEGAND_PCINT_GROUPS 1
+#endif
+
+WiegandReceiver::PinChangeEntry WiegandReceiver::_pcint_table[WIEGAND_PCINT_PINS];
+uint8_t WiegandReceiver::_pcint_count;
+volatile uint8_t * WiegandReceiver::_pcint_input[WIEGAND_PCINT_GROUPS];
+uint8_t WiegandReceiver::_pcint_state[WIEGAND_PCINT_GROUPS];
+uint8_t WiegandReceiver::_pcint_enabled[WIEGAND_PCINT_GROUPS];
+
+// one ISR per pin change group serves all buses on it
+ISR(PCINT0_vect) {WiegandReceiver::pinChange(0);}
+#if WIEGAND_PCINT_GROUPS > 1
+ISR(PCINT1_vect) {WiegandReceiver::pinChange(1);}
+#endif
+#if WIEGAND_PCINT_GROUPS > 2
+ISR(PCINT2_vect) {WiegandReceiver::pinChange(2);}
+#endif
+
+// reads group input register once and passes every falling edge to its instance
+void WiegandReceiver::pinChange(const uint8_t group)
+{
+	uint8_t state = *_pcint_input[group];
+	uint8_t fell = _pcint_state[group] & ~state & _pcint_enabled[group];
+	_pcint_state[group] = state;
+
+	for (uint8_t i = 0; fell && i < _pcint_count; i++)
+	{
+		PinChangeEntry & entry = _pcint_table[i];
+		if (entry.group == group && (fell & entry.mask))
+		{
+			fell &= ~entry.mask;
+			entry.instance->readBit(entry.meaning);
+		}
+	}
+}
+
+// enables or disables pin in its group, called with interrupts disabled
+void WiegandReceiver::setPinChange(const byte pin, bool enable)
+{
+	uint8_t group = digitalPinToPCICRbit(pin);
+	uint8_t mask = digitalPinToBitMask(pin);
+
+	if (enable)
+	{
+		// pin could have changed while disabled, so its last state is read again
+		_pcint_state[group] = (_pcint_state[group] & ~mask) | (*_pcint_input[group] & mask);
+		_pcint_enabled[group] |= mask;
+		*digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+	}
+	else
+	{
+		*digitalPinToPCMSK(pin) &= ~_BV(digitalPinToPCMSKbit(pin));
+		_pcint_enabled[group] &= ~mask;
+	}
+}
+#endif
+
+// registers pin in pin change interrupt table and enables its group
+// returns false if pin can't be used
+bool WiegandReceiver::attachPinChange(const byte pin, bool meaning)
+{
+#if defined(WIEGAND_PCINT)
+	if (digitalPinToPCICR(pin) == NULL || _pcint_count >= WIEGAND_PCINT_PINS)
+	{
+		return false;
+	}
+
+	uint8_t group = digitalPinToPCICRbit(pin);
+	uint8_t mask = digitalPinToBitMask(pin);
+	volatile uint8_t * input = portInputRegister(digitalPinToPort(pin));
+
+	// all pins in a group must be read from the same input register
+	if (group >= WIEGAND_PCINT_GROUPS || (_pcint_input[group] != NULL && _pcint_input[group] != input))
+	{
+		return false;
+	}
+	
+	// pin is already used
+	for (uint8_t i = 0; i < _pcint_count; i++)
+	{
+		if (_pcint_table[i].group == group && _pcint_table[i].mask == mask)
+		{
+			return false;
+		}
+	}
+
+	PinChangeEntry & entry = _pcint_table[_pcint_count++];
+	entry.instance = this;
+	entry.group = group;
+	entry.mask = mask;
+	entry.meaning = meaning;
+	_pcint_input[group] = input;
+	setPinChange(pin, true);
+
+	PCIFR = _BV(group);
+	*digitalPinToPCICR(pin) |= _BV(group);
+	return true;
+#else
+	(void)pin;
+	(void)meaning;
+	return false;
+#endif
+}
+
+// removes pin of this instance from pin change interrupt table
+// group stays enabled, its ISR ignores pins which are not enabled
+void WiegandReceiver::detachPinChange(const byte pin)
+{
+#if defined(WIEGAND_PCINT)
+	uint8_t group = digitalPinToPCICRbit(pin);
+	uint8_t mask = digitalPinToBitMask(pin);
+	for (uint8_t i = 0; i < _pcint_count; i++)
+	{
+		if (_pcint_table[i].instance == this && _pcint_table[i].group == group && _pcint_table[i].mask == mask)
+		{
+			setPinChange(pin, false);
+			_pcint_table[i] = _pcint_table[--_pcint_count];
+			return;
+		}
+	}
+#else
+	(void)pin;
+#endif
+}
+
+// all initialized instances
+WiegandReceiver * WiegandReceiver::_instances;
+
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+// Timer1 overflows seen by ISRs of all instances
+uint8_t WiegandReceiver::_timer1_epoch;
+
+// returns micros() time of edge being handled and Timer1 count it was computed from
+// time of previous edge of this instance is carried forward by Timer1 difference, micros() is
+// called only when no message is being received and after Timer1 overflowed since previous edge
+// called from ISR only
+uint32_t WIEGAND_ISR_ATTR WiegandReceiver::edgeMicros(uint16_t & ticks)
+{
+	ticks = TCNT1;
+	bool overflowed = _edge_epoch != _timer1_epoch;
+	if (TIFR1 & _BV(TOV1))
+	{
+		// overflow is taken here if count didn't wrap since the read, and can't wrap before
+		// flag is cleared, otherwise flag is left for next edge
+		uint16_t now = TCNT1;
+		if (now >= ticks && now < 0xFFF0)
+		{
+			TIFR1 = _BV(TOV1);
+			_timer1_epoch++;
+		}
+		overflowed = true;
+	}
+
+	// previous edge may be any time ago when no message is being received (idle, discarding
+	// after error, or consumer took the message), since epoch of other instances can advance by
+	// a multiple of 256 meanwhile, otherwise counter may have wrapped more than once since
+	// previous edge, which is told by micros() with a margin for its resolution
+	if (_status != Receiving || (int8_t)(_queue_head - _queue_tail) < 0
+		|| (overflowed && micros() - _edge_micros >= WIEGAND_TIMER1_PERIOD - 64))
+	{
+		_edge_micros = micros();
+		_edge_rest = 0;
+	}
+	else
+	{
+		// counter wrapped at most once, so difference of 16 bit counts is exact
+		uint32_t elapsed = (uint16_t)(ticks - _edge_ticks) + _edge_rest;
+		_edge_micros += elapsed / WIEGAND_TIMER1_TICKS;
+		_edge_rest = elapsed % WIEGAND_TIMER1_TICKS;
+	}
+	_edge_ticks = ticks;
+	_edge_epoch = _timer1_epoch;
+	return _edge_micros;
+}
+#endif
 
 // class instance to handle an interrupt
-void Wiegand::readBit(bool val)
+void WIEGAND_ISR_ATTR WiegandReceiver::readBit(bool val)
 {
 
 	// if instance is not initialized don't do anything
@@ -249,82 +331,176 @@ void Wiegand::readBit(bool val)
 		return;
 	}
 
-	// we can't receive anything while in error, bailing out
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	uint16_t current_ticks;
+	uint32_t current_micros = edgeMicros(current_ticks);
+#else
+	uint32_t current_micros = micros();
+#endif
+
+#if defined(WIEGAND_CAPTURE)
+	// raw edge is recorded even if it is rejected later
+	uint8_t capture_head = _capture_head;
+	if ((uint8_t)(capture_head - _capture_tail) < WIEGAND_CAPTURE)
+	{
+		WiegandEdge & edge = _capture[capture_head & (WIEGAND_CAPTURE - 1)];
+		edge.micros = current_micros;
+		edge.line = val;
+		WIEGAND_BARRIER();
+		_capture_head = capture_head + 1;
+	}
+	else
+	{
+		_seq++;
+		WIEGAND_COUNT(capture_overruns);
+	}
+#endif
+
+	// tells readers of internal state that it may have changed under them
+	_seq++;
+
+	// rest of a bad message is discarded until bus is quiet for a bit timeout, then this edge
+	// starts a new message, so receiving recovers without help from the application
 	if (_status == Error)
-	{	
-		return;
+	{
+		if (current_micros - _bit_micros <= bitTimeout())
+		{
+			_bit_micros = current_micros;
+			return;
+		}
+		resync();
 	}
-	
-	unsigned long current_micros = micros();
 
-	// new message started before last one was fully consumed
-	// TODO - implement some kind of message buffer if needed
-	if (_status == Done)
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	// edge is a spike if its line doesn't stay low long enough, with 0 it is only checked once
+	const WiegandHal::Input & input = val ? _high_input : _low_input;
+	if (WiegandHal::level(input))
 	{
-		// clear internal state
-		_status = Idle;
-		_first_micros = micros();
-		_bit_count = 0;
-		for (byte i = 0; i < WIEGAND_MAX_BYTES; i++)
+		WIEGAND_COUNT(glitches);
+		return;
+	}
+#if WIEGAND_MIN_PULSE_WIDTH > 0
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	while ((uint16_t)(TCNT1 - current_ticks) < WIEGAND_MIN_PULSE_WIDTH * WIEGAND_TIMER1_TICKS)
+#else
+	while (micros() - current_micros < WIEGAND_MIN_PULSE_WIDTH)
+#endif
+	{
+		if (WiegandHal::level(input))
 		{
-			_rcv_buffer[i] = 0;
+			WIEGAND_COUNT(glitches);
+			return;
 		}
-Serial.print("buffer overrun");
 	}
-	// this covers rare situation when micros counter overflows in the middle of message
-	// since it's very rare we simply set internal eror and let the rest of method to propagate it to public state
-	else if (_status == Receiving && current_micros < _bit_micros)
+#endif
+#endif
+
+	// intervals are differences of unsigned values, so they stay right when micros counter
+	// overflows in the middle of message
+#if defined(WIEGAND_MIN_BIT_INTERVAL)
+	// no reader sends bits this fast, so edge is noise
+	if (_status == Receiving && current_micros - _bit_micros < WIEGAND_MIN_BIT_INTERVAL)
 	{
-		_status = Error;
+		WIEGAND_COUNT(glitches);
 		return;
 	}
-	// new message started before last one was consumed
-	// TODO - implement some kind of message buffer if needed
-	else if (_status == Receiving && current_micros - _bit_micros > WIEGAND_MAX_BIT_INTERVAL)
+#endif
+
+	// new message started before anybody polled for the last one, so queue it here
+	if (_status == Receiving && current_micros - _bit_micros > bitTimeout())
 	{
-		// clear internal state
-		_status = Idle;
-		_first_micros = micros();
-		_bit_count = 0;
-		for (byte i = 0; i < WIEGAND_MAX_BYTES; i++)
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+		// message of no known length which ended under WIEGAND_MAX_BIT_INTERVAL was probably split
+		// by a learned timeout which is too short, so this interval is learned to raise it again
+		if (current_micros - _bit_micros < WIEGAND_MAX_BIT_INTERVAL
+			&& WiegandFormat::find(_bit_count) == WiegandFormat::Unknown)
 		{
-			_rcv_buffer[i] = 0;
+			learnInterval(current_micros - _bit_micros);
 		}
-Serial.print("buffer overrun");
+#endif
+		completeMessage();
+	}
+#if defined(WIEGAND_STATS)
+	else if (_status == Receiving && current_micros - _bit_micros > _stats.max_bit_interval)
+	{
+		_stats.max_bit_interval = current_micros - _bit_micros;
+	}
+#endif
+
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	// learn bit interval of this reader, intervals shorter than any reader sends are bounces
+	if (_status == Receiving && current_micros - _bit_micros >= WIEGAND_ADAPTIVE_MIN_INTERVAL)
+	{
+		learnInterval(current_micros - _bit_micros);
 	}
+#endif
+
+#if defined(WIEGAND_MESSAGE_TIMING)
 	// if new message is just starting, record starting timestamp
-	else if (_status == Idle)
+	if (_status == Idle)
 	{
-		_first_micros = micros();
+		_first_micros = current_micros;
 	}
+#endif
 
-	// check bit counter against max and increment it
-	if (_bit_count++ >= WIEGAND_MAX_BITS)
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	// both lines low means the bit can't be told, message is marked and times out as usual
+	if (!WiegandHal::level(val ? _low_input : _high_input))
 	{
+		WIEGAND_COUNT(collisions);
+		_collision = true;
+		_bit_micros = current_micros;
+		_status = Receiving;
+		return;
+	}
+#endif
+
+	// message is too long, so it is discarded, error is reported to consumer once
+	if (_bit_count >= _max_bits)
+	{
+		WIEGAND_COUNT(bit_limit_errors);
+		_errors++;
+		_bit_micros = current_micros;
 		_status = Error;
 		return;
 	}
 	
 	// enter receiving status and store bit timestamp
-	_bit_micros = micros();
+	_bit_micros = current_micros;
 	_status = Receiving;
 
-	// rotate bits in buffer and store new bit in LSB position
-	for (int8_t i = WIEGAND_MAX_BYTES - 1; i > 0 ; i--)
+	// store bit at its position in order of arrival, buffer is cleared at message start so only
+	// ones need to be written, bit order is fixed up once when message is latched
+	if (val)
 	{
-		_rcv_buffer[i] <<= 1;
-		_rcv_buffer[i] |= _rcv_buffer[i - 1] >> 7;
+		receiveBuffer()[_bit_count >> 3] |= 1 << (_bit_count & 7);
+		_parity ^= WiegandFormat::parityColumn(_bit_count);
 	}
-	_rcv_buffer[0] <<= 1;
-	_rcv_buffer[0] |= val;
+	_bit_count++;
+	WIEGAND_COUNT(bits);
 
-	//Serial.print(bit_value, DEC);
-	//Serial.print(_status);
-	//Serial.print(status);
-	//Serial.print(" ");
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	// message has length of last card message and valid parity, so there is no need to wait
+	if (_bit_count == _expected_bits && WiegandFormat::checkParity(_bit_count, _parity))
+	{
+		completeMessage();
+	}
+#endif
+
+#if defined(WIEGAND_STATS)
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	unsigned long isr_micros = (uint16_t)(TCNT1 - current_ticks) / WIEGAND_TIMER1_TICKS;
+#else
+	unsigned long isr_micros = micros() - current_micros;
+#endif
+	if (isr_micros > _stats.max_isr_micros)
+		_stats.max_isr_micros = isr_micros;
+#endif
 }
 
-void Wiegand::clear(bool make_atomic)
+// make_atomic is kept for compatibility, clear never disables interrupts
+// message that is being received is kept and will be queued when completed
+void WiegandReceiver::clear(bool /* make_atomic */)
 {
 	// if instance is not initialized don't do anything
 	if (_status == Uninitialized)
@@ -332,26 +508,301 @@ void Wiegand::clear(bool make_atomic)
 		return;
 	}
 
-	if (make_atomic)
-		noInterrupts();
-	
-	_status = Idle;
+	// ISR recovers from errors by itself, clearing only acknowledges them
+	if (status == Error)
+	{
+		_errors_seen = _errors;
+	}
+
 	status = Idle;
-	_first_micros = micros();
-	_bit_micros = _first_micros;
-	_bit_count = 0;
 	bit_count = 0;
-	for (byte i = 0; i < WIEGAND_MAX_BYTES; i++)
+	for (byte i = 0; i < maxBytes(); i++)
 	{
-		_rcv_buffer[i] = 0;
 		rcv_buffer[i] = 0;
 	}
-		
-	if (make_atomic)
-		interrupts();
 }
 
-void Wiegand::print()
+// clears internal state and prepares it for the next message
+// must be called from ISR, or while ISR ignores bits (uninitialized)
+void WIEGAND_ISR_ATTR WiegandReceiver::resetMessage()
+{
+	_bit_count = 0;
+	_parity = 0;
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	_collision = false;
+#endif
+	uint8_t * buffer = receiveBuffer();
+	for (byte i = 0; i < maxBytes(); i++)
+	{
+		buffer[i] = 0;
+	}
+
+	// ISR starts accepting bits when it sees Idle, so state must be reset before that
+	WIEGAND_BARRIER();
+	_status = Idle;
+}
+
+// drops rest of bad message once bus went quiet and prepares for the next one
+// called from ISR only
+void WIEGAND_ISR_ATTR WiegandReceiver::resync()
+{
+	WIEGAND_COUNT(resyncs);
+	resetMessage();
+}
+
+// moves received message into queue and resets internal state
+// called from ISR only, which makes it the only queue producer
+// message is stored in order of arrival, it is fixed up by consumer in acceptMessage
+void WIEGAND_ISR_ATTR WiegandReceiver::completeMessage()
+{
+	uint8_t head = _queue_head;
+	int8_t pending = head - _queue_tail;
+
+	_seq++;
+
+	// consumer already took this message when it timed out, tail is one ahead of head
+	if (pending < 0)
+	{
+		_queue_head = head + 1;
+	}
+	// if queue is full, new message is lost
+	else if (pending < WIEGAND_QUEUE_SIZE)
+	{
+		uint8_t index = head & (WIEGAND_QUEUE_SIZE - 1);
+		copyMessage(_queue[index], queueBuffer(index));
+
+		// message must be fully written before it becomes visible to consumer
+		WIEGAND_BARRIER();
+		_queue_head = head + 1;
+	}
+	else
+	{
+		WIEGAND_COUNT(overruns);
+	}
+
+	resetMessage();
+}
+
+// copies message being received, in order of arrival, into queue entry or WiegandMessage and
+// its bits into buffer
+template <class T> void WIEGAND_ISR_ATTR WiegandReceiver::copyMessage(T & message, uint8_t * buffer)
+{
+	message.bit_count = _bit_count;
+#if defined(WIEGAND_MESSAGE_TIMING)
+	message.total_micros = _bit_micros - _first_micros;
+	message.end_micros = _bit_micros;
+#endif
+	message.parity = _parity;
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	message.collision = _collision;
+#endif
+	const uint8_t * received = receiveBuffer();
+	for (byte i = 0; i < maxBytes(); i++)
+		buffer[i] = received[i];
+}
+
+// fixes bit order of message taken from queue and checks its parity, called by consumer only
+// returns false if message is corrupted and should be dropped
+bool WiegandReceiver::acceptMessage(WiegandMessage & message)
+{
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	// collision was already counted by ISR
+	if (message.collision)
+	{
+		return false;
+	}
+#endif
+
+#if defined(WIEGAND_CHECK_PARITY)
+	// message of known format with wrong parity is corrupted, so it is dropped
+	if (!WiegandFormat::checkParity(message.bit_count, message.parity))
+	{
+		WIEGAND_COUNT(parity_errors);
+		return false;
+	}
+#endif
+
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	// remember length of card messages, keypad messages vary so they are not used
+	WiegandFormat::WiegandFormatType format = WiegandFormat::find(message.bit_count);
+	if (format != WiegandFormat::Unknown && format != WiegandFormat::Keypad4 && format != WiegandFormat::Keypad8
+		&& WiegandFormat::checkParity(message.bit_count, message.parity))
+	{
+		_expected_bits = message.bit_count;
+	}
+#endif
+
+	// bits are stored in order of arrival, reverse them so that last received bit ends up
+	// in LSB of rcv_buffer[0], as if they were shifted in one by one
+	uint8_t * buffer = message.rcv_buffer;
+	for (uint8_t i = 0, pos = message.bit_count - 1; i < message.bit_count / 2; i++, pos--)
+	{
+		bool low = buffer[i >> 3] & (1 << (i & 7));
+		bool high = buffer[pos >> 3] & (1 << (pos & 7));
+		if (low != high)
+		{
+			buffer[i >> 3] ^= 1 << (i & 7);
+			buffer[pos >> 3] ^= 1 << (pos & 7);
+		}
+	}
+
+#if defined(WIEGAND_REPEAT_WINDOW)
+	if (isRepeat(message))
+	{
+		return false;
+	}
+#endif
+
+	WIEGAND_COUNT(messages);
+	return true;
+}
+
+#if defined(WIEGAND_REPEAT_WINDOW)
+// returns true if the same message was accepted less than WIEGAND_REPEAT_WINDOW ms ago,
+// otherwise remembers it in place of least recently seen one, called by consumer only
+bool WiegandReceiver::isRepeat(const WiegandMessage & message)
+{
+	// pressing the same key again is a new key press (i.e. digits of a PIN), not a repeat
+	WiegandFormat::WiegandFormatType format = WiegandFormat::find(message.bit_count);
+	if (format == WiegandFormat::Keypad4 || format == WiegandFormat::Keypad8)
+	{
+		return false;
+	}
+
+	// FNV-1a hash of length and received bytes
+	uint32_t fingerprint = 2166136261UL ^ message.bit_count;
+	fingerprint *= 16777619UL;
+	for (uint8_t i = 0; i < (message.bit_count + 7) / 8; i++)
+	{
+		fingerprint ^= message.rcv_buffer[i];
+		fingerprint *= 16777619UL;
+	}
+
+	unsigned long now = millis();
+	uint8_t oldest = 0;
+	for (uint8_t i = 0; i < WIEGAND_REPEAT_CACHE; i++)
+	{
+		RepeatEntry & entry = _repeats[i];
+		if (entry.bit_count == message.bit_count && entry.fingerprint == fingerprint
+			&& now - entry.millis < WIEGAND_REPEAT_WINDOW)
+		{
+			entry.millis = now;
+			WIEGAND_COUNT(repeat_hits);
+			return true;
+		}
+
+		// empty entries are used first
+		if (_repeats[oldest].bit_count != 0
+			&& (entry.bit_count == 0 || now - entry.millis > now - _repeats[oldest].millis))
+		{
+			oldest = i;
+		}
+	}
+
+	_repeats[oldest].fingerprint = fingerprint;
+	_repeats[oldest].millis = now;
+	_repeats[oldest].bit_count = message.bit_count;
+	WIEGAND_COUNT(repeat_misses);
+	return false;
+}
+#endif
+
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+// adds interval between bits to running average
+void WIEGAND_ISR_ATTR WiegandReceiver::learnInterval(const uint16_t interval)
+{
+	_bit_interval = _bit_interval - (_bit_interval >> 3) + (interval >> 3);
+}
+#endif
+
+// returns time after last bit at which message is considered complete
+unsigned long WIEGAND_ISR_ATTR WiegandReceiver::bitTimeout()
+{
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	unsigned long timeout = (unsigned long)_bit_interval * WIEGAND_ADAPTIVE_TIMEOUT;
+	if (timeout < WIEGAND_MAX_BIT_INTERVAL)
+	{
+		return timeout;
+	}
+#endif
+	return WIEGAND_MAX_BIT_INTERVAL;
+}
+
+// returns true if message being received timed out and wasn't taken by consumer yet
+// internal state may change during the call unless called from ISR, so caller must check _seq
+// now may be read before last bit arrived, so difference is compared as signed
+bool WIEGAND_ISR_ATTR WiegandReceiver::timedOut(const uint32_t now)
+{
+	return _status == Receiving && (int8_t)(_queue_head - _queue_tail) >= 0
+		&& (int32_t)(now - _bit_micros) > (int32_t)bitTimeout();
+}
+
+// takes oldest message from queue, or message being received if it timed out
+// runs with interrupts enabled, if ISR ran while internal state was being read, _seq changes
+// and the read is repeated
+bool WiegandReceiver::popMessage(WiegandMessage & message, const uint32_t now)
+{
+	// message may be longer than messages of this instance, its unused bytes stay clear
+	for (byte i = maxBytes(); i < WIEGAND_MAX_BYTES; i++)
+		message.rcv_buffer[i] = 0;
+
+	for (;;)
+	{
+		uint8_t tail = _queue_tail;
+		int8_t pending = _queue_head - tail;
+		WIEGAND_BARRIER();
+
+		if (pending > 0)
+		{
+			uint8_t index = tail & (WIEGAND_QUEUE_SIZE - 1);
+			const QueueEntry & entry = _queue[index];
+			message.bit_count = entry.bit_count;
+#if defined(WIEGAND_MESSAGE_TIMING)
+			message.total_micros = entry.total_micros;
+			message.end_micros = entry.end_micros;
+#endif
+			message.parity = entry.parity;
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+			message.collision = entry.collision;
+#endif
+			const uint8_t * buffer = queueBuffer(index);
+			for (byte i = 0; i < maxBytes(); i++)
+				message.rcv_buffer[i] = buffer[i];
+
+			// slot must be fully copied before it is handed back to producer
+			WIEGAND_BARRIER();
+			_queue_tail = tail + 1;
+		}
+		else
+		{
+			uint8_t seq = _seq;
+			WIEGAND_BARRIER();
+			bool timed_out = timedOut(now);
+			if (timed_out)
+				copyMessage(message, message.rcv_buffer);
+			WIEGAND_BARRIER();
+			if (seq != _seq)
+			{
+				continue;
+			}
+			if (!timed_out)
+			{
+				return false;
+			}
+
+			// message is taken by moving tail one ahead of head, ISR moves head when next message
+			// starts, if it does so before this line it finds the queue empty and does the same
+			_queue_tail = tail + 1;
+		}
+
+		if (acceptMessage(message))
+		{
+			return true;
+		}
+	}
+}
+
+void WiegandReceiver::print()
 {
 	
 	// if instance is not initialized don't do anything
@@ -365,10 +816,14 @@ void Wiegand::print()
 		case Done:			
 			Serial.print("Wiegand status = Done, Received ");
 			Serial.print(bit_count);
-			Serial.print(" bits, in ");
+			Serial.print(" bits, ");
+#if defined(WIEGAND_MESSAGE_TIMING)
+			Serial.print("in ");
 			Serial.print(total_micros);
-			Serial.print("us rcv_buffer = {");
-			for (int8_t i = WIEGAND_MAX_BYTES - 1; i >= 0 ; i--)
+			Serial.print("us ");
+#endif
+			Serial.print("rcv_buffer = {");
+			for (int8_t i = maxBytes() - 1; i >= 0 ; i--)
 			{
 					Serial.print(rcv_buffer[i], HEX);
 				if (i > 0)
@@ -388,7 +843,7 @@ void Wiegand::print()
 	}
 }
 
-bool Wiegand::finishRead()
+bool WiegandReceiver::finishRead()
 {
 	// if instance is not initialized don't do anything
 	if (_status == Uninitialized)
@@ -396,106 +851,349 @@ bool Wiegand::finishRead()
 		return false;
 	}
 
-	// this method is usually called from high frequency loops
-	// so it must be atomic
-	noInterrupts();
-	unsigned long current_micros = micros();
-	// this covers rare situation when micros counter overflows in the middle of message
-	// since it's very rare we simply set internal eror and let the rest of method to propagate it to public state
-	if (_status == Receiving && current_micros < _bit_micros)
+	// last message wasn't cleared yet
+	if (status == Done)
 	{
-		_status = Error;
+		return false;
 	}
-	if (_status == Receiving && current_micros - _bit_micros > WIEGAND_MAX_BIT_INTERVAL)
-	{	
-		// latch all internal data into public members
-		_status = Done;
+
+	// latch next queued message into public members
+	WiegandMessage message;
+	if (popMessage(message, micros()))
+	{
 		status = Done;
-		bit_count = _bit_count;
-		total_micros = _bit_micros - _first_micros;
-		for (byte i = 0; i < WIEGAND_MAX_BYTES; i++)
-			rcv_buffer[i] = _rcv_buffer[i];
+		bit_count = message.bit_count;
+#if defined(WIEGAND_MESSAGE_TIMING)
+		total_micros = message.total_micros;
+#endif
+		_latched_parity = message.parity;
+		for (byte i = 0; i < maxBytes(); i++)
+			rcv_buffer[i] = message.rcv_buffer[i];
 
-		interrupts();
 		return true;
 	}
 
+	// error is reported until it is cleared, even if ISR already recovered from it
+	if (_errors != _errors_seen)
+	{
+		status = Error;
+		return false;
+	}
+
+	// message which was taken by consumer is no longer being received, and rest of bad message
+	// which is being discarded is of no interest to consumer
 	status = _status;
-	
-	interrupts();
-	
+	if ((status == Receiving && (int8_t)(_queue_head - _queue_tail) < 0) || status == Error)
+		status = Idle;
+
 	return false;
 }
 
-void Wiegand::suspend()
+// returns number of completed messages waiting in queue
+// messages with wrong parity are counted, but are dropped by read
+uint8_t WiegandReceiver::available()
 {
 	// if instance is not initialized don't do anything
 	if (_status == Uninitialized)
 	{
-		return;
+		return 0;
+	}
+
+	int8_t pending;
+	bool timed_out;
+	uint8_t seq;
+	uint32_t now = micros();
+	do
+	{
+		seq = _seq;
+		WIEGAND_BARRIER();
+		pending = _queue_head - _queue_tail;
+		timed_out = timedOut(now);
+		WIEGAND_BARRIER();
 	}
+	while (seq != _seq);
 
-	detachPin(_low_int_pin);
-	detachPin(_high_int_pin);
+	// message which timed out is taken after queued ones
+	return (pending > 0 ? pending : 0) + (timed_out ? 1 : 0);
 }
 
-void Wiegand::resume()
+// takes oldest completed message from queue
+// returns false if there are no messages waiting
+bool WiegandReceiver::read(WiegandMessage & message)
 {
 	// if instance is not initialized don't do anything
 	if (_status == Uninitialized)
 	{
-		return;
+		return false;
 	}
 
-	attachPin(_low_int_pin);
-	attachPin(_high_int_pin);
+	return popMessage(message, micros());
 }
 
+// links initialized instance into list used by Wiegand::tick and Wiegand::dispatch
+// called from begin with interrupts disabled
+void WiegandReceiver::addInstance()
+{
+	_next_instance = _instances;
+	_instances = this;
 
-void Wiegand::attachPin(const byte pin)
+#if defined(WIEGAND_TIMER0_TICK)
+	// Arduino uses Timer0 overflow for millis, its compare match A interrupt fires once per
+	// overflow for any OCR0A, which gives a tick of about 1ms. OCR0A also sets PWM duty of pin 6
+	// (Uno), so it is left as analogWrite set it, which only moves the tick within the period
+	bitSet(TIMSK0, OCIE0A);
+#endif
+
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	// Timer1 counts freely in normal mode without interrupts, overflow flag is polled by ISR
+	TCCR1A = 0;
+	TCCR1B = _BV(CS11);
+	TIMSK1 = 0;
+	TIFR1 = _BV(TOV1);
+#endif
+}
+
+// queues timed out messages of all instances, so they are ready before anybody polls
+// must be called from a timer ISR, since only ISRs may add messages to queue
+void WIEGAND_ISR_ATTR WiegandReceiver::tick()
 {
-	switch(pin)
+	uint32_t now = micros();
+	for (WiegandReceiver * instance = _instances; instance != NULL; instance = instance->_next_instance)
 	{
-#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
-		case 2: bitSet(EIFR, INT0); bitSet(EIMSK, INT0); break;
-		case 3: bitSet(EIFR, INT1); bitSet(EIMSK, INT1); break;
-#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-		case 2: bitSet(EIFR, INT4); bitSet(EIMSK, INT4); break;
-		case 3: bitSet(EIFR, INT5); bitSet(EIMSK, INT5); break;
-		case 21: bitSet(EIFR, INT0); bitSet(EIMSK, INT0); break;
-		case 20: bitSet(EIFR, INT1); bitSet(EIMSK, INT1); break;
-		case 19: bitSet(EIFR, INT2); bitSet(EIMSK, INT2); break;
-		case 18: bitSet(EIFR, INT3); bitSet(EIMSK, INT3); break;
-#elif defined (__AVR_ATmega32U4__)
-		case 3: bitSet(EIFR, INT0); bitSet(EIMSK, INT0); break;
-		case 2: bitSet(EIFR, INT1); bitSet(EIMSK, INT1); break;
-		case 0: bitSet(EIFR, INT2); bitSet(EIMSK, INT2); break;
-		case 1: bitSet(EIFR, INT3); bitSet(EIMSK, INT3); break;
-		case 7: bitSet(EIFR, INT6); bitSet(EIMSK, INT6); break;
+		if (instance->timedOut(now))
+		{
+			instance->completeMessage();
+		}
+		// bus went quiet after a bad message
+		else if (instance->_status == Error && now - instance->_bit_micros > instance->bitTimeout())
+		{
+			instance->_seq++;
+			instance->resync();
+		}
+	}
+}
+
+// calls callbacks for all queued messages and errors of all instances
+// must be called from loop, error callback is called once per discarded message
+void WiegandReceiver::dispatch()
+{
+	WiegandMessage message;
+
+	for (WiegandReceiver * instance = _instances; instance != NULL; instance = instance->_next_instance)
+	{
+		if (instance->_on_message == NULL && instance->_on_error == NULL)
+		{
+			continue;
+		}
+
+		while (instance->popMessage(message, micros()))
+		{
+			if (instance->_on_message != NULL)
+				instance->_on_message(*instance, message);
+		}
+
+		uint8_t errors = instance->_errors;
+		if (errors != instance->_errors_seen)
+		{
+			instance->_errors_seen = errors;
+			if (instance->_on_error != NULL)
+				instance->_on_error(*instance);
+		}
+	}
+}
+
+// sleeps until next interrupt unless a message of any instance is ready to be taken
+// must be called from loop, returns false if it didn't sleep
+bool WiegandReceiver::sleep()
+{
+#if defined(WIEGAND_SLEEP)
+	// ISR can't complete or start a message between the check and sleep
+	noInterrupts();
+	uint32_t now = micros();
+	bool receiving = false;
+	bool pin_change = true;
+	for (WiegandReceiver * instance = _instances; instance != NULL; instance = instance->_next_instance)
+	{
+		if ((int8_t)(instance->_queue_head - instance->_queue_tail) > 0 || instance->timedOut(now))
+		{
+			interrupts();
+			return false;
+		}
+
+		// timeout and resync after error need micros(), edges of external interrupts need I/O clock
+		// message taken by consumer after it timed out is no longer being received
+		if ((instance->_status == Receiving && (int8_t)(instance->_queue_head - instance->_queue_tail) >= 0)
+			|| instance->_status == Error)
+			receiving = true;
+		if (!instance->_pin_change)
+			pin_change = false;
+	}
+
+#if defined(__AVR__)
+	set_sleep_mode(receiving || !pin_change ? SLEEP_MODE_IDLE : WIEGAND_SLEEP);
+	sleep_enable();
+	// instruction after sei always runs before a pending interrupt, so CPU can't miss it
+	interrupts();
+	sleep_cpu();
+	sleep_disable();
+	return true;
+#elif defined(__arm__)
+	(void)receiving;
+	(void)pin_change;
+	// wfi wakes on pending interrupt even while interrupts are disabled
+	__asm__ __volatile__ ("wfi");
+	interrupts();
+	return true;
+#else
+	(void)receiving;
+	(void)pin_change;
+	interrupts();
+	return false;
+#endif
+#else
+	// without WIEGAND_SLEEP loop just polls
+	return false;
+#endif
+}
+
+void WiegandReceiver::onMessage(WiegandMessageCallback callback)
+{
+	_on_message = callback;
+}
+
+void WiegandReceiver::onError(WiegandErrorCallback callback)
+{
+	_on_error = callback;
+}
+
+#if defined(WIEGAND_TIMER0_TICK)
+ISR(TIMER0_COMPA_vect) {WiegandReceiver::tick();}
+#endif
+
+// returns view of latched message, valid until it is cleared or next one is latched
+WiegandFrame WiegandReceiver::frame() const
+{
+	return WiegandFrame(rcv_buffer, status == Done ? bit_count : 0);
+}
+
+// decodes latched message using known card formats
+// returns false if there is no latched message or its length doesn't match any format
+bool WiegandReceiver::decode(WiegandCard & card)
+{
+	if (status != Done)
+	{
+		return false;
+	}
+
+	return WiegandFormat::decode(bit_count, rcv_buffer, _latched_parity, card);
+}
+
+#if defined(WIEGAND_STATS)
+// copies statistics, copy is repeated if ISR changed them meanwhile
+void WiegandReceiver::getStats(WiegandStats & stats)
+{
+	uint8_t seq;
+	do
+	{
+		seq = _seq;
+		WIEGAND_BARRIER();
+		stats = _stats;
+		WIEGAND_BARRIER();
+	}
+	while (seq != _seq);
+}
+
+void WiegandReceiver::resetStats()
+{
+	uint8_t seq;
+	do
+	{
+		seq = _seq;
+		WIEGAND_BARRIER();
+		memset(&_stats, 0, sizeof(_stats));
+		WIEGAND_BARRIER();
+	}
+	while (seq != _seq);
+}
 #endif
+
+#if defined(WIEGAND_CAPTURE)
+// takes oldest captured edge
+// returns false if there are no edges waiting
+bool WiegandReceiver::readEdge(WiegandEdge & edge)
+{
+	uint8_t tail = _capture_tail;
+	if (tail == _capture_head)
+	{
+		return false;
 	}
+
+	WIEGAND_BARRIER();
+	edge = _capture[tail & (WIEGAND_CAPTURE - 1)];
+
+	// slot must be fully copied before it is handed back to ISR
+	WIEGAND_BARRIER();
+	_capture_tail = tail + 1;
+	return true;
 }
 
-void Wiegand::detachPin(const byte pin)
+// prints and removes all captured edges, one per line, in format read by extras/replay
+void WiegandReceiver::dumpCapture(Print & output)
 {
-	switch(pin)
+	WiegandEdge edge;
+	while (readEdge(edge))
+	{
+		output.print("edge ");
+		output.print(edge.line ? 1 : 0);
+		output.print(' ');
+		output.println(edge.micros);
+	}
+}
+#endif
+
+void WiegandReceiver::suspend()
+{
+	// if instance is not initialized don't do anything
+	if (_status == Uninitialized)
 	{
-#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
-		case 2: bitClear(EIMSK, INTF0); break;
-		case 3: bitClear(EIMSK, INTF1); break;
-#elif defined(__AVR_ATmega1280__) && defined(__AVR_ATmega2560__)
-		case 2: bitClear(EIMSK, INTF4); break;
-		case 3: bitClear(EIMSK, INTF5); break;
-		case 21: bitClear(EIMSK, INTF0); break;
-		case 20: bitClear(EIMSK, INTF1); break;
-		case 19: bitClear(EIMSK, INTF2); break;
-		case 18: bitClear(EIMSK, INTF3); break;
-#elif defined (__AVR_ATmega32U4__)
-		case 3: bitClear(EIMSK, INTF0); break;
-		case 2: bitClear(EIMSK, INTF1); break;
-		case 0: bitClear(EIMSK, INTF2); break;
-		case 1: bitClear(EIMSK, INTF3); break;
-		case 7: bitClear(EIMSK, INTF6); break;
+		return;
+	}
+
+#if defined(WIEGAND_PCINT)
+	if (_pin_change)
+	{
+		noInterrupts();
+		setPinChange(_low_int_pin, false);
+		setPinChange(_high_int_pin, false);
+		interrupts();
+		return;
+	}
 #endif
+
+	WiegandHal::enable(_low_int_pin, false);
+	WiegandHal::enable(_high_int_pin, false);
+}
+
+void WiegandReceiver::resume()
+{
+	// if instance is not initialized don't do anything
+	if (_status == Uninitialized)
+	{
+		return;
 	}
+
+#if defined(WIEGAND_PCINT)
+	if (_pin_change)
+	{
+		noInterrupts();
+		setPinChange(_low_int_pin, true);
+		setPinChange(_high_int_pin, true);
+		interrupts();
+		return;
+	}
+#endif
+
+	WiegandHal::enable(_low_int_pin, true);
+	WiegandHal::enable(_high_int_pin, true);
 }
+
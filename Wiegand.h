@@ -45,7 +45,8 @@
  * Class must be initialized before use by calling Wiegand::begin method. If begin returns false,
  * initialization failed and library will not function properly. This happens if you target an
  * unsupported board, provide constructor with pins that don't support hardware interrupts, use the
- * same pin more than once or call begin on already initialized instance.
+ * same pin more than once or call begin on already initialized instance. Failed begin releases
+ * any pin it already took and leaves instance uninitialized, so begin can be called again.
  * Most methods will return error or do nothing if class is uninitialized (Wiegand::Uninitialized)
  * Member variables rcv_buffer, bit_count and status contain received data, number of received
  * bits, and current status of instance. They are public to make the code smaller, but you should
@@ -60,19 +61,165 @@
  * to library use.
  * After consuming the data, user should call Wigand::clear to change the state back to 
  * Wigand::Idle and prepare the instance for next message.
- * If new message starts before last one was consumed, internal status will be automatically changed
- * to Wiegand::Receiving and last message will be lost. Message buffered by Wiegand::finishRead will
- * not be cleared and can be processed regardless of this.
- * If error is encountered, state is changed to Wigand::Error and Wigand::clear method must be
- * called before any more data can be received.
+ * Completed messages are kept in a small queue of WIEGAND_QUEUE_SIZE messages, so new message can
+ * start before last one was consumed. Message is queued by ISR when next message starts before
+ * anybody polled for the previous one, otherwise Wiegand::finishRead (or Wiegand::read) takes it
+ * directly once WIEGAND_MAX_BIT_INTERVAL has passed. Wiegand::finishRead latches one message into
+ * public members at a time and keeps it there (status stays Wiegand::Done) until Wiegand::clear
+ * is called, after which next queued message is latched. Wiegand::clear doesn't discard message
+ * that is currently being received.
+ * Alternatively, messages can be taken from the queue with Wiegand::available and Wiegand::read.
+ * Don't mix the two approaches on the same instance. If queue is full when a message is
+ * completed, the new message is lost.
+ * Queue is single producer (ISR) single consumer (main loop) ring, and only ISRs write internal
+ * state. ISR increments a sequence counter (_seq) whenever it runs, and main loop methods repeat
+ * their read if the counter changed meanwhile, so none of them disable interrupts. Longest time
+ * with interrupts disabled caused by each public method is:
+ *   begin				whole method, which attaches interrupts and sets pin modes
+ *   finishRead, read, available, dispatch
+ *						none, apart from micros() itself (a few cycles) while message is received
+ *   suspend, resume	none with external interrupts, a few register writes with pin change ones
+ *   tick				runs from a timer ISR with interrupts disabled, like any other ISR
+ *   sleep				a micros() call and a pass over all instances before CPU sleeps, so an
+ *						edge in between wakes it, none without WIEGAND_SLEEP
+ *   all other methods	none
+ * If message is longer than capacity of the instance, ISR discards it and ignores the bus until it
+ * has been quiet for a bit timeout, after which next edge starts a new message. Receiving recovers
+ * on its own, no call from application is needed. Wiegand::finishRead reports the error once as
+ * Wiegand::Error status, which stays until Wiegand::clear, and Wiegand::dispatch calls the error
+ * callback once. Wiegand::tick, if used, returns instance to Idle as soon as the bus is quiet.
  * Timing is done via micros() function and relies on standard Arduino settings for micros() timer.
+ * All intervals are differences of unsigned timestamps, so they stay right when micros() wraps
+ * around (every 71 minutes), also in the middle of a message. Timestamps are kept as uint32_t,
+ * so this holds on PC builds too, where unsigned long is 64 bits wide.
  * Message start is stored in _first_micros member variable and is used for filling total_micros
- * member variable. It was added just to provide info so it can be optimized out by modifying
- * library code. Last bit time is stored in _bit_micros member variable.
+ * member variable. It is just info, so both are removed when WIEGAND_MESSAGE_TIMING is not
+ * defined. Last bit time is stored in _bit_micros member variable.
+ * Each edge costs ISR a micros() call, one more per pass of WIEGAND_MIN_PULSE_WIDTH wait and one
+ * for WIEGAND_STATS ISR time, and micros() on AVR has 4us resolution. When
+ * WIEGAND_TIMER1_TIMESTAMPS is defined on AVR, Timer1 runs freely with prescaler 8 (0.5us per tick
+ * at 16MHz, 1us at 8MHz) and ISR reads its 16 bit count once per edge. Time of an edge is time of
+ * previous edge of the same instance plus the 16 bit difference of counts, so intervals inside a
+ * message are exact to a tick. micros() is called when no message is being received (also after
+ * consumer took a timed out one), and on the first edge after Timer1 overflowed (every 32ms at
+ * 16MHz) to check that the count didn't wrap more than once.
+ * ISRs tell overflows from the overflow flag, without an overflow interrupt. Pulse width wait and
+ * ISR time read Timer1 only. Timestamps stay in micros() units, so consumer side, which compares
+ * them with micros(), doesn't change. Timer1 is taken from analogWrite on its pins (9 and 10 on
+ * Uno) and from libraries which use it (Servo, TimerOne), and must not be changed by the sketch.
  * Buffering and autofinishing were late additions and are probably not bug free. If you expect
  * receiving messages with minimum timings, you should do heavy testing.
+ * For testing without hardware the library can be compiled on a PC with WIEGAND_HAL_HOST defined,
+ * against a replacement Arduino.h which provides micros(), noInterrupts(), interrupts(),
+ * digitalRead(), pinMode() and Serial. Nothing is attached to real interrupts then, falling edges
+ * are fed by calling WiegandHal::edge with the pin number, and time is controlled through micros().
+ * PROGMEM tables fall back to ordinary memory there. extras/test holds such Arduino.h, a signal
+ * simulator with an interrupt controller which behaves like the one on AVR, unit tests and a
+ * throughput benchmark (make check, make bench), and extras/replay replays recorded edge traces.
+ * Parity of standard card formats is tracked while bits are received (see WiegandFormat.h).
+ * Messages which have length of a known format but wrong parity are discarded when they are taken
+ * from queue, unless WIEGAND_CHECK_PARITY is undefined. Wiegand::decode and WiegandFormat::decode
+ * return facility code and card number of latched or queued message.
+ * When WIEGAND_ADAPTIVE_TIMEOUT is defined, each instance learns the interval between bits of its
+ * reader and completes message after WIEGAND_ADAPTIVE_TIMEOUT such intervals instead of waiting
+ * the whole WIEGAND_MAX_BIT_INTERVAL. Learning starts from WIEGAND_MAX_BIT_INTERVAL, intervals
+ * under 200us (or WIEGAND_MIN_BIT_INTERVAL if longer) are bounces and are not learned, and an
+ * interval which ended a message of no known length under WIEGAND_MAX_BIT_INTERVAL is learned, so
+ * a timeout which got too short grows back. It also remembers length of last card message and
+ * completes next one as soon as its last bit arrives with valid parity. This assumes reader sends
+ * one card format only, since a longer message whose beginning happens to have valid parity would
+ * be split.
+ * Latched message can be read through Wiegand::frame, and any message through WiegandFrame, which
+ * is a view of its buffer without a copy. WiegandFrame returns whole message as integer, single
+ * bits, or groups of bits by their position, with mask computed at compile time when position
+ * is a template argument.
+ * Instead of polling, messages can also be handled by callbacks set with Wiegand::onMessage and
+ * Wiegand::onError. Static method Wiegand::dispatch, called from loop, calls callbacks for queued
+ * and timed out messages and errors of all instances outside of interrupt context. Callbacks get
+ * the instance as WiegandReceiver, common base of all capacities (see WiegandT). Optional static
+ * method Wiegand::tick queues timed out messages of all instances so dispatch finds them ready, it
+ * must be called from a timer ISR about once per millisecond. When WIEGAND_TIMER0_TICK is defined,
+ * library calls it from Timer0 compare A interrupt, which Arduino leaves unused. Its compare
+ * register OCR0A is however the PWM duty of pin 6 on Uno (pin 13 on Mega, 11 on Leonardo). The
+ * library doesn't write it, so analogWrite on that pin keeps working and only shifts the tick
+ * within the millisecond, but Timer0 must stay in the mode and prescaler Arduino sets.
+ * When WIEGAND_STATS is defined, ISR counts received bits, completed and lost messages and errors
+ * and records the longest ISR run and bit interval. Wiegand::getStats returns a consistent copy of
+ * them, so missed reads in the field can be traced to their cause.
+ * On long cables induced spikes show up as extra edges. When WIEGAND_MIN_PULSE_WIDTH is defined,
+ * ISR reads the line whose edge it handles and rejects the edge if the line doesn't stay low for
+ * that many microseconds, measured from ISR entry (0 only checks that it is still low). It also
+ * reads the other line, and if both are low the edge is not decoded. Message it belongs to is
+ * then marked as collision and dropped when taken from queue. When WIEGAND_MIN_BIT_INTERVAL is
+ * defined, edges closer than that to the previous bit are rejected as well. Both checks are a
+ * few register reads and compares, only the pulse width wait adds its length to ISR time.
+ * Readers often send the same card two or three times while it is presented. When
+ * WIEGAND_REPEAT_WINDOW is defined, each instance remembers fingerprints of the last
+ * WIEGAND_REPEAT_CACHE accepted messages, and a message equal to one of them (same length and
+ * bits) seen less than WIEGAND_REPEAT_WINDOW milliseconds ago is dropped when taken from queue.
+ * Each repeat restarts the window, so card held at reader is reported once. The least recently
+ * seen entry is replaced by new messages. Statistics count dropped repeats and passed messages.
+ * Keypad messages are never dropped, since the same key pressed twice is two key presses.
  * Methods Wiegand::suspend and Wiegand::resume temporarily disable pin interrupts. This can be
  * useful if you need to completely ignore bus messages for a while
+ * Battery powered devices can define WIEGAND_SLEEP and call static method Wiegand::sleep at the
+ * end of loop instead of polling all the time. It returns at once if a message of any instance
+ * is ready to be taken. Otherwise it puts CPU to sleep until next interrupt: a bit, a timer tick,
+ * serial data and so on. Check and sleep are atomic, so an edge arriving in between still wakes
+ * it. While a message is being received, AVR sleeps in idle mode, where Timer0 keeps micros()
+ * running and its overflow interrupt wakes CPU about once per millisecond, so message is ready
+ * at most about 1ms after its timeout ran out (with WIEGAND_TIMER0_TICK the tick itself
+ * completes it). Watchdog can't do better, its shortest period is 16ms. Between messages mode
+ * WIEGAND_SLEEP is used. External interrupts detect edges only while I/O clock runs, so with
+ * them (and WiegandDirect) it is always idle. Deeper modes (SLEEP_MODE_PWR_DOWN,
+ * SLEEP_MODE_STANDBY) are used only if all buses use pin change interrupts, which wake CPU
+ * from any mode. There first edge is read only if CPU wakes up before the pulse ends (50-100us),
+ * which needs short start-up fuses (i.e. internal oscillator or 258 CK crystal start-up, not
+ * 16K CK of Uno bootloader fuses), and millis() and micros() stop while asleep, which makes
+ * WIEGAND_REPEAT_WINDOW and application timing count only awake time. On ARM boards CPU waits
+ * for interrupt (wfi), system tick wakes it every millisecond. On other boards, and on every
+ * board when WIEGAND_SLEEP is not defined, it returns false at once, so loop simply polls.
+ * Per datasheets idle cuts AVR core current to roughly a quarter or third of active current at
+ * the same clock, wake-up from idle takes a few cycles, so no bit is lost, and the message is
+ * ready within WIEGAND_MAX_BIT_INTERVAL (or adaptive timeout) plus 1ms after its last bit. On
+ * an Uno board, USB interface and regulator draw more than the processor, so savings show only
+ * on bare boards.
+ * When a reader misbehaves, its raw signal can be recorded by defining WIEGAND_CAPTURE. ISR then
+ * stores line and micros() of every edge it gets, before any checks, into a buffer of
+ * WIEGAND_CAPTURE edges. Edges are taken from it one by one with Wiegand::readEdge, or printed
+ * by Wiegand::dumpCapture as lines "edge <line> <micros>". When buffer is full, new edges are
+ * counted in statistics and dropped. Such dumps can be replayed on a PC through the same
+ * decoder with extras/replay (see replay.cpp there), faster than real time.
+ * Message capacity is template argument of class WiegandT<bits>, Wiegand is WiegandT with
+ * WIEGAND_MAX_BITS, which is also the largest capacity since WiegandMessage is sized by it.
+ * Only buffers of the instance depend on it, code is in base class WiegandReceiver and shared by
+ * all capacities, so i.e. WiegandT<26> for a card reader and WiegandT<8> for a keypad add only
+ * their constructors to flash. Longer messages are counted as bit limit errors.
+ * RAM used by one instance on AVR, with B = (bits + 7) / 8 and Q = WIEGAND_QUEUE_SIZE, is
+ * 29 + 2B + Q(B + 3) bytes, plus:
+ *   WIEGAND_MESSAGE_TIMING		8 + 8Q
+ *   WIEGAND_STATS				24, plus 2 for glitches, 2 for collisions and 8 for repeats
+ *   WIEGAND_ADAPTIVE_TIMEOUT	3
+ *   WIEGAND_MIN_PULSE_WIDTH	7 + Q
+ *   WIEGAND_REPEAT_WINDOW		9 per WIEGAND_REPEAT_CACHE entry
+ *   WIEGAND_CAPTURE			2 + 5 per WIEGAND_CAPTURE entry, plus 2 for statistics
+ *   WIEGAND_TIMER1_TIMESTAMPS	8, plus 1 shared by all instances
+ * Enums take one byte when compiled as C++11 (Arduino 1.6.6 and later), two bytes otherwise.
+ * Default settings (B = 5, Q = 4) take 135 bytes. Reading 26 bit cards only (WiegandT<26>, so
+ * B = 4) with Q = 1 and without timing and statistics takes 44 bytes. All instances share 2
+ * bytes of instance list and the interrupt registry (see WiegandHal.h, 5 bytes on Uno, 13 on
+ * Mega), WIEGAND_PCINT adds 5 bytes per WIEGAND_PCINT_PINS and 4 per group.
+ * Class template WiegandDirect<DATA0 pin, DATA1 pin> is a variant which binds pins at compile time
+ * and programs external interrupt registers directly, instead of going through attachInterrupt.
+ * Its ISRs are installed in the sketch with WIEGAND_DIRECT_ISR macro, which calls
+ * Wiegand::readBit straight from the interrupt vector. This skips the Arduino dispatch table
+ * load and indirect call, the slot ISR of WiegandHal and the instance pointer load. Counting
+ * instructions of both paths that is about 12-15 cycles (close to 1us at 16MHz) less per bit,
+ * register saving in ISR prologue stays the same since both call readBit. Pin mismatch is
+ * caught by the compiler. Because Arduino core defines all INTx vectors together
+ * with attachInterrupt, WIEGAND_DIRECT_ISR_ONLY must be defined in this file when WiegandDirect
+ * is used, and then only WiegandDirect instances can be used. Optional third
+ * template argument is message capacity, as of WiegandT.
  * 
  *
  *
@@ -88,8 +235,15 @@
  * Mega2560 has 6 such pins (first two are physically compatible with Uno) so you can choose which
  * of them to use. Also, this allows you to connect to a maximum of 3 physical Wiegand buses.
  * Leonard has five interrupt pins, but they are not pin compatible with Uno.
- * Other boards are not supported, but you can easily fix that by mapping them in
- * Wiegand::attachInterrupts method.
+ * On other boards (SAMD, ESP32, ESP8266, RP2040, ...) any pin for which digitalPinToInterrupt
+ * returns an interrupt can be used, and there can be as many buses as there are such pin pairs.
+ * Pins are handled by edge source backend of the board, see WiegandHal.h.
+ * If you need more buses, define WIEGAND_PCINT and call
+ * Wiegand::begin(Wiegand::PinChangeInterrupts). Any pins with pin change interrupts can then be
+ * used, up to WIEGAND_PCINT_PINS in total. All buses on the same port share one ISR, which reads
+ * the port once and decodes falling edges of all its pins in one pass. On Mega2560 pins of one pin
+ * change group must also be on the same port (group 1 mixes port E and J, so only one of them can
+ * be used).
  *
  */
 
@@ -102,68 +256,428 @@
 #else
 	#include "WProgram.h"
 #endif
+#include "WiegandFormat.h"
 
 #define WIEGAND_MAX_BIT_INTERVAL 5000	// max time between two bits in microseconds
-#define WIEGAND_MAX_BITS 36				// max number of bits 
+//#define WIEGAND_ADAPTIVE_TIMEOUT 3	// uncomment to complete messages after this many learned bit
+										// intervals, WIEGAND_MAX_BIT_INTERVAL stays the upper limit
+#define WIEGAND_MAX_BITS 37				// max number of bits, capacity of Wiegand (see WiegandT)
 										// max number of storage bytes calculated from MAX_BYTES (do not change)
 #define WIEGAND_MAX_BYTES (WIEGAND_MAX_BITS / 8 + (WIEGAND_MAX_BITS % 8 == 0 ? 0 : 1))
+//#define WIEGAND_DIRECT_ISR_ONLY		// uncomment to use WiegandDirect instead of Wiegand
+//#define WIEGAND_PCINT					// uncomment to enable pin change interrupts, conflicts with other
+										// libraries using them (i.e. SoftwareSerial)
+#define WIEGAND_PCINT_PINS 8			// max number of pins using pin change interrupts (two per bus)
+#define WIEGAND_CHECK_PARITY			// comment out to keep messages of known formats with wrong parity
+//#define WIEGAND_TIMER0_TICK			// uncomment to call Wiegand::tick from Timer0 compare interrupt
+#define WIEGAND_STATS					// comment out to remove statistics
+#define WIEGAND_MESSAGE_TIMING			// comment out to remove message duration (total_micros)
+#define WIEGAND_QUEUE_SIZE 4			// number of completed messages that can be queued
+										// must be a power of two and not more than 64
+//#define WIEGAND_MIN_PULSE_WIDTH 10	// uncomment to reject pulses shorter than this many microseconds
+//#define WIEGAND_MIN_BIT_INTERVAL 100	// uncomment to reject bits closer than this many microseconds
+//#define WIEGAND_TIMER1_TIMESTAMPS		// uncomment to time edges with Timer1 instead of micros(), AVR
+										// only, takes Timer1 from PWM on its pins, Servo and TimerOne
+//#define WIEGAND_REPEAT_WINDOW 2000	// uncomment to drop messages repeated within this many milliseconds
+#define WIEGAND_REPEAT_CACHE 4			// number of recent messages remembered for repeat check
+//#define WIEGAND_CAPTURE 64			// uncomment to record this many raw edges per instance
+										// must be a power of two and not more than 128
+//#define WIEGAND_INTERRUPT_SLOTS 16	// uncomment to override number of interrupt registry slots
+										// (see WiegandHal.h), not more than 255
+//#define WIEGAND_SLEEP SLEEP_MODE_IDLE	// uncomment to enable Wiegand::sleep, value is AVR sleep mode
+										// used between messages
 
+#include "WiegandHal.h"
 
-class Wiegand
+
+// completed message as stored in message queue
+struct WiegandMessage
+{
+	uint8_t bit_count;
+	uint8_t rcv_buffer[WIEGAND_MAX_BYTES];
+#if defined(WIEGAND_MESSAGE_TIMING)
+	unsigned long total_micros;
+	unsigned long end_micros;		// micros() of last bit
+#endif
+	uint16_t parity;				// parity word, see WiegandFormat
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	bool collision;					// both lines were low at once, bits can't be trusted
+#endif
+};
+
+
+// raw edge, as recorded by capture
+struct WiegandEdge
+{
+	unsigned long micros;
+	bool line;						// false for DATA0, true for DATA1
+};
+
+
+// read-only view of message bits, last bit is in LSB of buffer[0]
+// positions are counted from first received bit, starting with 0
+class WiegandFrame
 {
+	private:
+		const uint8_t * _buffer;
+		uint8_t _bit_count;
+
+		// returns bits from position low up (counted from last bit), unmasked
+		uint64_t window(const uint8_t low, const uint8_t len) const
+		{
+			uint64_t value = 0;
+			for (int8_t i = (low + len - 1) >> 3; i >= (int8_t)(low >> 3); i--)
+				value = (value << 8) | _buffer[i];
+			return value >> (low & 7);
+		}
+
 	public:
-		enum WiegandStatus {Uninitialized, Idle, Receiving, Done, Error};
+		WiegandFrame(const uint8_t * buffer, const uint8_t bit_count)
+			:_buffer(buffer), _bit_count(bit_count) {}
+		WiegandFrame(const WiegandMessage & message)
+			:_buffer(message.rcv_buffer), _bit_count(message.bit_count) {}
+
+		uint8_t bitCount() const {return _bit_count;}
+		const uint8_t * buffer() const {return _buffer;}
+
+		bool bit(const uint8_t pos) const
+		{
+			uint8_t low = _bit_count - 1 - pos;
+			return _buffer[low >> 3] & (1 << (low & 7));
+		}
+
+		// whole message as integer, first bit is the highest, toUint32 keeps last 32 bits only
+		uint32_t toUint32() const {return window(0, _bit_count < 32 ? _bit_count : 32);}
+		uint64_t toUint64() const {return window(0, _bit_count);}
+
+		// len bits starting at offset, len must be 1-32 and bits must be in message
+		uint32_t bits(const uint8_t offset, const uint8_t len) const
+		{
+			return window(_bit_count - offset - len, len) & (0xFFFFFFFFUL >> (32 - len));
+		}
+
+		// same with position and length known at compile time, so mask is a constant
+		template <uint8_t OFFSET, uint8_t LEN> uint32_t bits() const
+		{
+			return window(_bit_count - OFFSET - LEN, LEN) & (uint32_t)(((uint64_t)1 << LEN) - 1);
+		}
+};
+
+
+// receiver statistics, all counters run since begin or last Wiegand::resetStats
+struct WiegandStats
+{
+	unsigned long bits;				// bits received
+	unsigned long messages;			// messages completed and queued
+	uint16_t overruns;				// messages lost because queue was full
+	uint16_t bit_limit_errors;		// messages longer than capacity of the instance
+	uint16_t resyncs;				// returns to Idle after bus went quiet following an error
+	uint16_t parity_errors;			// messages of known format dropped because of wrong parity
+	unsigned long max_isr_micros;	// longest time spent in readBit
+	unsigned long max_bit_interval;	// longest interval between two bits of the same message
+#if defined(WIEGAND_MIN_PULSE_WIDTH) || defined(WIEGAND_MIN_BIT_INTERVAL)
+	uint16_t glitches;				// edges rejected as too short or too close to previous bit
+#endif
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	uint16_t collisions;			// edges seen while both lines were low
+#endif
+#if defined(WIEGAND_CAPTURE)
+	uint16_t capture_overruns;		// edges not captured because capture buffer was full
+#endif
+#if defined(WIEGAND_REPEAT_WINDOW)
+	unsigned long repeat_hits;		// messages dropped as repeats
+	unsigned long repeat_misses;	// messages checked and passed on
+#endif
+};
+
+
+class WiegandReceiver;
+
+// callbacks used by Wiegand::dispatch
+typedef void (*WiegandMessageCallback)(WiegandReceiver & wiegand, const WiegandMessage & message);
+typedef void (*WiegandErrorCallback)(WiegandReceiver & wiegand);
+
+
+// receiver code shared by all message capacities, its buffers are storage of WiegandT
+class WiegandReceiver
+{
+	public:
+		enum WiegandStatus WIEGAND_ENUM_BYTE {Uninitialized, Idle, Receiving, Done, Error};
+		enum WiegandInterrupts WIEGAND_ENUM_BYTE {ExternalInterrupts, PinChangeInterrupts};
+
+	friend class WiegandHub;
+	friend class WiegandHal;
 
 	private:
-		static void isr0_low ();
-		static void isr1_low ();
-		static void isr2_low ();
-		static void isr3_low ();
-		static void isr4_low ();
-		static void isr5_low ();
-
-		static void isr0_high ();
-		static void isr1_high ();
-		static void isr2_high ();
-		static void isr3_high ();
-		static void isr4_high ();
-		static void isr5_high ();
-
-		static Wiegand * _int0_instance;
-		static Wiegand * _int1_instance;
-		static Wiegand * _int2_instance;
-		static Wiegand * _int3_instance;
-		static Wiegand * _int4_instance;
-		static Wiegand * _int5_instance;
+		static WiegandReceiver * _instances;
+
+#if defined(WIEGAND_PCINT)
+		// pin change interrupt registration, one entry per pin
+		struct PinChangeEntry
+		{
+			WiegandReceiver * instance;
+			uint8_t group;		// pin change interrupt group, same as PCIE bit
+			uint8_t mask;		// pin bit in group input register
+			bool meaning;
+		};
+
+		static PinChangeEntry _pcint_table[WIEGAND_PCINT_PINS];
+		static uint8_t _pcint_count;
+		// per group input register, last read state and mask of pins not suspended
+		static volatile uint8_t * _pcint_input[];
+		static uint8_t _pcint_state[];
+		static uint8_t _pcint_enabled[];
+
+		void setPinChange(const byte pin, bool enable);
+#endif
 		
+	protected:
 		const byte _low_int_pin;
 		const byte _high_int_pin;
 		
 		void readBit(bool val);
-		bool attachInterrupts(const byte pin, bool meaning);
-		void attachPin(const byte pin);
-		void detachPin(const byte pin);
+		bool attachPinChange(const byte pin, bool meaning);
+		void detachPinChange(const byte pin);
+		void completeMessage();
+		template <class T> void copyMessage(T & message, uint8_t * buffer);
+		bool acceptMessage(WiegandMessage & message);
+		bool timedOut(const uint32_t now);
+		void resetMessage();
+		void resync();
+		unsigned long bitTimeout();
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+		void learnInterval(const uint16_t interval);
+#endif
+		bool popMessage(WiegandMessage & message, const uint32_t now);
+		void addInstance();
 
-		unsigned long _first_micros;
-		unsigned long _bit_micros;
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+		// time of last edge and Timer1 count, remainder and overflow epoch it was computed from
+		static uint8_t _timer1_epoch;
+		uint32_t _edge_micros;
+		uint16_t _edge_ticks;
+		uint8_t _edge_rest;
+		uint8_t _edge_epoch;
+		uint32_t edgeMicros(uint16_t & ticks);
+#endif
 
-		uint8_t _rcv_buffer[WIEGAND_MAX_BYTES];
+#if defined(WIEGAND_MESSAGE_TIMING)
+		uint32_t _first_micros;
+#endif
+		uint32_t _bit_micros;
+
+		const uint8_t _max_bits;
 		uint8_t _bit_count; 
-		WiegandStatus _status;
+		uint16_t _parity;
+		uint16_t _latched_parity;
+		volatile WiegandStatus _status;
+		bool _pin_change;
+
+		// queued message, its bits are kept in queue buffer of the same index
+		struct QueueEntry
+		{
+			uint8_t bit_count;
+#if defined(WIEGAND_MESSAGE_TIMING)
+			unsigned long total_micros;
+			unsigned long end_micros;
+#endif
+			uint16_t parity;
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+			bool collision;
+#endif
+		};
+
+		// message queue, _queue_head is written only by producer (ISR) and _queue_tail only by
+		// consumer, both run freely and wrap around, tail is one ahead of head when consumer
+		// took timed out message before ISR queued it
+		QueueEntry _queue[WIEGAND_QUEUE_SIZE];
+		volatile uint8_t _queue_head;
+		volatile uint8_t _queue_tail;
+
+		// incremented by ISR, readers of internal state repeat the read if it changed meanwhile
+		volatile uint8_t _seq;
+
+		// errors counted by ISR, and the count last reported to consumer
+		volatile uint8_t _errors;
+		uint8_t _errors_seen;
+
+		WiegandReceiver * _next_instance;
+		WiegandMessageCallback _on_message;
+		WiegandErrorCallback _on_error;
+
+#if defined(WIEGAND_STATS)
+		WiegandStats _stats;
+#endif
+
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+		uint16_t _bit_interval;		// learned interval between bits
+		uint8_t _expected_bits;		// length of last card message
+#endif
+
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+		// both lines, sampled by ISR
+		WiegandHal::Input _low_input;
+		WiegandHal::Input _high_input;
+		bool _collision;
+#endif
+
+#if defined(WIEGAND_CAPTURE)
+		// captured edges, _capture_head is written only by ISR and _capture_tail only by consumer
+		WiegandEdge _capture[WIEGAND_CAPTURE];
+		volatile uint8_t _capture_head;
+		volatile uint8_t _capture_tail;
+#endif
+
+#if defined(WIEGAND_REPEAT_WINDOW)
+		// recently accepted messages, entry with bit_count 0 is empty
+		struct RepeatEntry
+		{
+			uint32_t fingerprint;
+			unsigned long millis;
+			uint8_t bit_count;
+		};
+
+		RepeatEntry _repeats[WIEGAND_REPEAT_CACHE];
+		bool isRepeat(const WiegandMessage & message);
+#endif
+
+		// storage bytes of one message, buffers of message being received and of queue entries
+		// follow rcv_buffer in storage
+		uint8_t maxBytes() const {return (_max_bits + 7) >> 3;}
+		uint8_t * receiveBuffer() const {return rcv_buffer + maxBytes();}
+		uint8_t * queueBuffer(const uint8_t index) const {return rcv_buffer + (index + 2) * maxBytes();}
+
+		// storage must hold (WIEGAND_QUEUE_SIZE + 2) messages of max_bits bits
+		WiegandReceiver(const byte low_int_pin, const byte high_int_pin, const uint8_t max_bits,
+			uint8_t * storage);
 
 	public:
 		WiegandStatus status;
 		uint8_t bit_count; 
-		uint8_t rcv_buffer[WIEGAND_MAX_BYTES];
+		uint8_t * const rcv_buffer;
+#if defined(WIEGAND_MESSAGE_TIMING)
 		unsigned long total_micros;
+#endif
 		
-		Wiegand(const byte low_int_pin, const byte high_int_pin);
+		uint8_t maxBits() const {return _max_bits;}
 		
-		bool begin();
+		bool begin(WiegandInterrupts mode = ExternalInterrupts);
 		void clear(bool make_atomic = true);
 		void print();
 		bool finishRead();
+		uint8_t available();
+		bool read(WiegandMessage & message);
+		bool decode(WiegandCard & card);
+		WiegandFrame frame() const;
+		void onMessage(WiegandMessageCallback callback);
+		void onError(WiegandErrorCallback callback);
+		static void tick();
+		static void dispatch();
+		static bool sleep();
+#if defined(WIEGAND_STATS)
+		void getStats(WiegandStats & stats);
+		void resetStats();
+#endif
 		void suspend();
 		void resume();
+#if defined(WIEGAND_CAPTURE)
+		bool readEdge(WiegandEdge & edge);
+		void dumpCapture(Print & output);
+#endif
+
+#if defined(WIEGAND_PCINT)
+		// for use by pin change ISRs only
+		static void pinChange(const uint8_t group);
+#endif
+};
+
+
+// receiver of messages up to BITS bits long, it takes (WIEGAND_QUEUE_SIZE + 2) * (BITS + 7) / 8
+// bytes of buffers, longer messages are errors as with WIEGAND_MAX_BITS
+template <uint8_t BITS>
+class WiegandT : public WiegandReceiver
+{
+#if __cplusplus >= 201103L
+		static_assert(BITS > 0 && BITS <= WIEGAND_MAX_BITS, "BITS must be 1 to WIEGAND_MAX_BITS");
+#endif
+
+		// rcv_buffer, message being received and queue entries, in this order
+		uint8_t _storage[(WIEGAND_QUEUE_SIZE + 2) * ((BITS + 7) / 8)];
+
+	public:
+		WiegandT(const byte low_int_pin, const byte high_int_pin)
+			:WiegandReceiver(low_int_pin, high_int_pin, BITS, _storage) {}
 };
+
+typedef WiegandT<WIEGAND_MAX_BITS> Wiegand;
+
+
+#if __cplusplus >= 201103L && defined(WIEGAND_HAL_AVR)
+// Wiegand receiver with pins bound at compile time, its interrupt vectors must be installed
+// with WIEGAND_DIRECT_ISR, using INTn_vect names where n is the Atmel number of pin interrupt
+// Board			pin:vector
+// Uno, Ethernet	2:INT0_vect		3:INT1_vect
+// Mega2560			2:INT4_vect		3:INT5_vect		21:INT0_vect	20:INT1_vect	19:INT2_vect	18:INT3_vect
+// Leonardo			3:INT0_vect		2:INT1_vect		0:INT2_vect		1:INT3_vect		7:INT6_vect
+template <byte DATA0_PIN, byte DATA1_PIN, uint8_t BITS = WIEGAND_MAX_BITS>
+class WiegandDirect : public WiegandT<BITS>
+{
+		static_assert(WiegandHal::pinToInterrupt(DATA0_PIN) >= 0, "DATA0 pin doesn't support external interrupts");
+		static_assert(WiegandHal::pinToInterrupt(DATA1_PIN) >= 0, "DATA1 pin doesn't support external interrupts");
+		static_assert(DATA0_PIN != DATA1_PIN, "DATA0 and DATA1 must use different pins");
+
+		// sets external interrupt to trigger on falling edge, clears its flag and enables it
+		static inline void enableInterrupt(const int8_t n)
+		{
+			if (n < 4)
+				EICRA = (EICRA & ~(3 << (2 * n))) | (2 << (2 * n));
+#ifdef EICRB
+			else
+				EICRB = (EICRB & ~(3 << (2 * (n - 4)))) | (2 << (2 * (n - 4)));
+#endif
+			EIFR = 1 << n;
+			EIMSK |= 1 << n;
+		}
+
+	public:
+		static constexpr int8_t data0_interrupt = WiegandHal::pinToInterrupt(DATA0_PIN);
+		static constexpr int8_t data1_interrupt = WiegandHal::pinToInterrupt(DATA1_PIN);
+
+		WiegandDirect() : WiegandT<BITS>(DATA0_PIN, DATA1_PIN) {}
+
+		// initializer
+		// returns true if successfull, false otherwise
+		bool begin()
+		{
+			// if instance is already initialized return false
+			if (this->_status != WiegandReceiver::Uninitialized)
+			{
+				return false;
+			}
+
+			noInterrupts();
+			pinMode(DATA0_PIN, INPUT);
+			pinMode(DATA1_PIN, INPUT);
+			enableInterrupt(data0_interrupt);
+			enableInterrupt(data1_interrupt);
+			this->resetMessage();
+			this->addInstance();
+			this->clear(false);
+			interrupts();
+
+			return true;
+		}
+
+		// for use by WIEGAND_DIRECT_ISR only
+		inline void readLow() {this->readBit(LOW);}
+		inline void readHigh() {this->readBit(HIGH);}
+};
+
+// installs interrupt vectors of WiegandDirect instance, must be used once at file scope, i.e.
+// WiegandDirect<2, 3> wiegand;
+// WIEGAND_DIRECT_ISR(wiegand, INT0_vect, INT1_vect)
+#define WIEGAND_DIRECT_ISR(instance, data0_vect, data1_vect) \
+	ISR(data0_vect) {instance.readLow();} \
+	ISR(data1_vect) {instance.readHigh();}
+#endif
 #endif
\ No newline at end of file
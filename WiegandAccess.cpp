@@ -0,0 +1,375 @@
+#include "WiegandAccess.h"
+
+#if defined(WIEGAND_ACCESS_EEPROM)
+#include <EEPROM.h>
+
+// size of one journal entry in EEPROM, id followed by operation
+#define WIEGAND_ACCESS_ENTRY 9
+
+// constructor for read-only table in PROGMEM, which must be sorted
+// changes are kept in journal at journal_address in EEPROM
+WiegandAccessList::WiegandAccessList(const uint64_t * flash_table, const uint16_t count, const int journal_address)
+	:_storage(Flash), _flash_table(flash_table), _count(count), _table_address(0), _capacity(count),
+	_journal_address(journal_address), _journal_count(0) {}
+
+// constructor for table at table_address in EEPROM, with room for capacity ids
+// changes are kept in journal at journal_address in EEPROM
+WiegandAccessList::WiegandAccessList(const int table_address, const uint16_t capacity, const int journal_address)
+	:_storage(Eeprom), _flash_table(NULL), _count(0), _table_address(table_address), _capacity(capacity),
+	_journal_address(journal_address), _journal_count(0) {}
+
+// returns id of card with given format, facility code and card number
+uint64_t WiegandAccessList::cardId(const WiegandFormat::WiegandFormatType format, const uint32_t facility, const uint32_t card)
+{
+	return WIEGAND_ACCESS_ID(format, facility, card);
+}
+
+uint64_t WiegandAccessList::cardId(const WiegandCard & card)
+{
+	return cardId(card.format, card.facility, card.card);
+}
+
+// reads table and journal sizes from EEPROM and builds bloom filter
+// erased EEPROM is treated as empty
+void WiegandAccessList::begin()
+{
+#if defined(WIEGAND_ACCESS_COMMIT)
+	// emulated EEPROM must cover table and journal, whichever ends later
+	int size = _journal_address + 1 + WIEGAND_ACCESS_JOURNAL * WIEGAND_ACCESS_ENTRY;
+	if (_storage == Eeprom && _table_address + 2 + _capacity * (int)sizeof(uint64_t) > size)
+	{
+		size = _table_address + 2 + _capacity * sizeof(uint64_t);
+	}
+	EEPROM.begin(size);
+#endif
+
+	if (_storage == Eeprom)
+	{
+		EEPROM.get(_table_address, _count);
+		if (_count > _capacity)
+		{
+			_count = 0;
+			EEPROM.put(_table_address, _count);
+		}
+	}
+
+	_journal_count = EEPROM.read(_journal_address);
+	if (_journal_count > WIEGAND_ACCESS_JOURNAL)
+	{
+		_journal_count = 0;
+		EEPROM.write(_journal_address, _journal_count);
+	}
+	commit();
+
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+	memset(_bloom, 0, sizeof(_bloom));
+	for (uint16_t i = 0; i < _count; i++)
+	{
+		bloomAdd(tableId(i));
+	}
+
+	uint64_t id;
+	for (uint8_t i = 0; i < _journal_count; i++)
+	{
+		EEPROM.get(_journal_address + 1 + i * WIEGAND_ACCESS_ENTRY, id);
+		if (EEPROM.read(_journal_address + 1 + i * WIEGAND_ACCESS_ENTRY + 8) == Add)
+			bloomAdd(id);
+	}
+#endif
+}
+
+// writes changes of emulated EEPROM to flash, EEPROM of AVR is written directly
+void WiegandAccessList::commit()
+{
+#if defined(WIEGAND_ACCESS_COMMIT)
+	EEPROM.commit();
+#endif
+}
+
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+// two bit positions are taken from one multiplicative hash of id, folded to 32 bits
+void WiegandAccessList::bloomAdd(const uint64_t id)
+{
+	uint32_t hash = ((uint32_t)id ^ (uint32_t)(id >> 32)) * 0x9E3779B1UL;
+	uint16_t a = (hash >> 16) & (WIEGAND_ACCESS_BLOOM_BYTES * 8 - 1);
+	uint16_t b = hash & (WIEGAND_ACCESS_BLOOM_BYTES * 8 - 1);
+	_bloom[a >> 3] |= 1 << (a & 7);
+	_bloom[b >> 3] |= 1 << (b & 7);
+}
+
+// returns false if id is certainly not in the list
+bool WiegandAccessList::bloomCheck(const uint64_t id)
+{
+	uint32_t hash = ((uint32_t)id ^ (uint32_t)(id >> 32)) * 0x9E3779B1UL;
+	uint16_t a = (hash >> 16) & (WIEGAND_ACCESS_BLOOM_BYTES * 8 - 1);
+	uint16_t b = hash & (WIEGAND_ACCESS_BLOOM_BYTES * 8 - 1);
+	return (_bloom[a >> 3] & (1 << (a & 7))) && (_bloom[b >> 3] & (1 << (b & 7)));
+}
+#endif
+
+uint64_t WiegandAccessList::tableId(const uint16_t index)
+{
+	uint64_t id;
+	if (_storage == Flash)
+		memcpy_P(&id, &_flash_table[index], sizeof(id));
+	else
+		EEPROM.get(_table_address + 2 + index * sizeof(id), id);
+	return id;
+}
+
+void WiegandAccessList::writeTableId(const uint16_t index, const uint64_t id)
+{
+	EEPROM.put(_table_address + 2 + index * sizeof(id), id);
+}
+
+// binary search of sorted table
+// returns true if id was found, index is set to its position, or to position where it belongs
+bool WiegandAccessList::tableFind(const uint64_t id, uint16_t & index)
+{
+	uint16_t low = 0;
+	uint16_t high = _count;
+	while (low < high)
+	{
+		uint16_t middle = low + (high - low) / 2;
+		uint64_t middle_id = tableId(middle);
+		if (middle_id == id)
+		{
+			index = middle;
+			return true;
+		}
+		if (middle_id < id)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	index = low;
+	return false;
+}
+
+// searches journal from newest entry
+// returns true if id was found, allowed is then set by its last operation
+bool WiegandAccessList::journalFind(const uint64_t id, bool & allowed)
+{
+	uint64_t entry_id;
+	for (uint8_t i = _journal_count; i > 0; i--)
+	{
+		int address = _journal_address + 1 + (i - 1) * WIEGAND_ACCESS_ENTRY;
+		EEPROM.get(address, entry_id);
+		if (entry_id == id)
+		{
+			allowed = EEPROM.read(address + 8) == Add;
+			return true;
+		}
+	}
+	return false;
+}
+
+// appends operation to journal, merging it into table first if it is full
+// returns false if there is no room left
+bool WiegandAccessList::journalAppend(const uint64_t id, const JournalOperation operation)
+{
+	if (_journal_count >= WIEGAND_ACCESS_JOURNAL && !compact())
+	{
+		return false;
+	}
+
+	int address = _journal_address + 1 + _journal_count * WIEGAND_ACCESS_ENTRY;
+	EEPROM.put(address, id);
+	EEPROM.write(address + 8, operation);
+
+	// entry is written before count, so power loss in between only loses this change
+	_journal_count++;
+	EEPROM.write(_journal_address, _journal_count);
+	commit();
+	return true;
+}
+
+// applies journal to EEPROM table and empties journal
+// journal is sorted and merged with table in one pass, so every id in table is moved at most once
+// returns false if table is read-only or would overflow, table is left unchanged then
+bool WiegandAccessList::compact()
+{
+	if (_storage == Flash)
+	{
+		return false;
+	}
+
+	// sorted changes, newest operation wins for ids which are in journal more than once
+	struct Change
+	{
+		uint64_t id;
+		uint16_t index;					// position of id in table, or position where it belongs
+		bool add;
+	} changes[WIEGAND_ACCESS_JOURNAL];
+	uint8_t change_count = 0;
+
+	uint64_t id;
+	for (uint8_t i = 0; i < _journal_count; i++)
+	{
+		int address = _journal_address + 1 + i * WIEGAND_ACCESS_ENTRY;
+		EEPROM.get(address, id);
+		bool add = EEPROM.read(address + 8) == Add;
+
+		uint8_t j = change_count;
+		while (j > 0 && changes[j - 1].id > id)
+			j--;
+		if (j > 0 && changes[j - 1].id == id)
+		{
+			changes[j - 1].add = add;
+			continue;
+		}
+		memmove(&changes[j + 1], &changes[j], (change_count - j) * sizeof(Change));
+		changes[j].id = id;
+		changes[j].add = add;
+		change_count++;
+	}
+
+	// changes which don't change table are dropped, others get their position in table
+	uint8_t count = 0;
+	uint16_t new_count = _count;
+	for (uint8_t i = 0; i < change_count; i++)
+	{
+		bool found = tableFind(changes[i].id, changes[i].index);
+		if (changes[i].add == found)
+			continue;
+		changes[count++] = changes[i];
+		if (found)
+			new_count--;
+		else
+			new_count++;
+	}
+	if (new_count > _capacity)
+	{
+		return false;
+	}
+
+	// ids between two changes are moved by number of adds minus number of removes before them
+	// ids moving down are moved first from the start, then ids moving up from the end, so no id
+	// is overwritten before it is moved
+	int16_t shift = 0;
+	for (uint8_t i = 0; i <= count; i++)
+	{
+		uint16_t first = i == 0 ? 0 : changes[i - 1].index + (changes[i - 1].add ? 0 : 1);
+		uint16_t last = i == count ? _count : changes[i].index;
+		if (shift < 0)
+		{
+			for (uint16_t j = first; j < last; j++)
+				writeTableId(j + shift, tableId(j));
+		}
+		if (i < count)
+			shift += changes[i].add ? 1 : -1;
+	}
+	for (uint8_t i = count + 1; i > 0; i--)
+	{
+		if (i - 1 < count)
+			shift -= changes[i - 1].add ? 1 : -1;
+		uint16_t first = i == 1 ? 0 : changes[i - 2].index + (changes[i - 2].add ? 0 : 1);
+		uint16_t last = i - 1 == count ? _count : changes[i - 1].index;
+		if (shift > 0)
+		{
+			for (uint16_t j = last; j > first; j--)
+				writeTableId(j - 1 + shift, tableId(j - 1));
+		}
+	}
+
+	// added ids go to the gaps left by moving, shift is again number of changes before them
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (changes[i].add)
+			writeTableId(changes[i].index + shift, changes[i].id);
+		shift += changes[i].add ? 1 : -1;
+	}
+
+	_count = new_count;
+	EEPROM.put(_table_address, _count);
+	_journal_count = 0;
+	EEPROM.write(_journal_address, _journal_count);
+	commit();
+	return true;
+}
+
+// returns true if card with given id is allowed
+bool WiegandAccessList::allowed(const uint64_t id)
+{
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+	if (!bloomCheck(id))
+	{
+		return false;
+	}
+#endif
+
+	bool allowed;
+	if (journalFind(id, allowed))
+	{
+		return allowed;
+	}
+
+	uint16_t index;
+	return tableFind(id, index);
+}
+
+// keypad messages and messages of unknown format are not cards, so they are never allowed
+bool WiegandAccessList::allowed(const WiegandCard & card)
+{
+	if (!card.parity_ok || card.format == WiegandFormat::Unknown
+		|| card.format == WiegandFormat::Keypad4 || card.format == WiegandFormat::Keypad8)
+	{
+		return false;
+	}
+	return allowed(cardId(card));
+}
+
+// allows card with given id
+// returns false if there is no room left
+bool WiegandAccessList::add(const uint64_t id)
+{
+	if (allowed(id))
+	{
+		return true;
+	}
+
+	if (!journalAppend(id, Add))
+	{
+		return false;
+	}
+
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+	bloomAdd(id);
+#endif
+	return true;
+}
+
+// disallows card with given id
+// returns false if there is no room left
+bool WiegandAccessList::remove(const uint64_t id)
+{
+	if (!allowed(id))
+	{
+		return true;
+	}
+
+	return journalAppend(id, Remove);
+}
+
+// removes all cards, PROGMEM table is only reset to its original content
+void WiegandAccessList::clear()
+{
+	if (_storage == Eeprom)
+	{
+		_count = 0;
+		EEPROM.put(_table_address, _count);
+	}
+
+	_journal_count = 0;
+	EEPROM.write(_journal_address, _journal_count);
+	commit();
+
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+	memset(_bloom, 0, sizeof(_bloom));
+	for (uint16_t i = 0; i < _count; i++)
+	{
+		bloomAdd(tableId(i));
+	}
+#endif
+}
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * ACCESS LIST
+ *
+ * Class WiegandAccessList decides if a decoded card is allowed. Cards are identified by 64 bit id
+ * made of format in upper 8 bits, facility code in next 32 bits and card number in lower 24 bits
+ * (see WIEGAND_ACCESS_ID), so every supported card format fits without two cards sharing an id,
+ * and the same numbers in different formats are different cards. Keypad messages and cards of
+ * unknown format or with wrong parity are never allowed.
+ * Allowed ids are kept sorted in a table, either in PROGMEM (read-only, given to constructor) or
+ * in EEPROM (first two bytes hold number of ids, followed by ids). Table is searched by binary
+ * search, so 4096 cards take at most 12 reads.
+ * Changes are not written into the table directly, they are appended to a small journal in
+ * EEPROM (first byte holds number of entries, each entry is id followed by add/remove byte).
+ * Lookup checks the journal first, newest entry wins. When journal is full, EEPROM table is
+ * merged with it in one pass, so every id is moved at most once, and journal is emptied. If the
+ * changes don't fit into the table, it is left as it was. With PROGMEM table nothing more can be
+ * changed after journal fills up, and add or remove returns false.
+ * EEPROM library of the board core is used, so the class is only available on AVR, ESP8266 and
+ * ESP32, and on a PC with WIEGAND_HAL_HOST, where EEPROM of the replacement Arduino.h is used. On
+ * other boards it is left out and the rest of the library builds without it. ESP cores emulate
+ * EEPROM in flash, begin then reserves the space used by table and journal, and every change is
+ * committed to flash before add, remove or clear returns.
+ * If WIEGAND_ACCESS_BLOOM_BYTES is not 0, a bloom filter of that size is kept in RAM and built
+ * by begin. Most unknown cards are then rejected without reading the table at all.
+ *
+ */
+
+
+#ifndef WiegandAccess_h_
+#define WiegandAccess_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+#include "WiegandFormat.h"
+
+#define WIEGAND_ACCESS_JOURNAL 16			// max number of journal entries (9 bytes of EEPROM each)
+#define WIEGAND_ACCESS_BLOOM_BYTES 64		// RAM used by bloom filter, power of two or 0 to disable
+
+// id of card with given format, facility code and card number, usable in PROGMEM tables
+#define WIEGAND_ACCESS_ID(format, facility, card) \
+	(((uint64_t)(format) << 56) | ((uint64_t)(uint32_t)(facility) << 24) | ((uint64_t)(card) & 0xFFFFFFUL))
+
+#if defined(__AVR__) || defined(ESP8266) || defined(ESP32) || defined(WIEGAND_HAL_HOST)
+	#define WIEGAND_ACCESS_EEPROM			// board core has EEPROM library (do not change)
+#endif
+#if defined(ESP8266) || defined(ESP32)
+	#define WIEGAND_ACCESS_COMMIT			// EEPROM is emulated in flash and needs begin and commit
+#endif
+
+#if defined(WIEGAND_ACCESS_EEPROM)
+
+class WiegandAccessList
+{
+	public:
+		enum WiegandAccessStorage {Flash, Eeprom};
+
+	private:
+		enum JournalOperation {Remove, Add};
+
+		const WiegandAccessStorage _storage;
+		const uint64_t * _flash_table;
+		uint16_t _count;				// number of ids in table
+		const int _table_address;
+		const uint16_t _capacity;
+		const int _journal_address;
+		uint8_t _journal_count;
+
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+		uint8_t _bloom[WIEGAND_ACCESS_BLOOM_BYTES];
+		void bloomAdd(const uint64_t id);
+		bool bloomCheck(const uint64_t id);
+#endif
+
+		uint64_t tableId(const uint16_t index);
+		void writeTableId(const uint16_t index, const uint64_t id);
+		bool tableFind(const uint64_t id, uint16_t & index);
+		bool journalFind(const uint64_t id, bool & allowed);
+		bool journalAppend(const uint64_t id, const JournalOperation operation);
+		bool compact();
+		void commit();
+
+	public:
+		WiegandAccessList(const uint64_t * flash_table, const uint16_t count, const int journal_address);
+		WiegandAccessList(const int table_address, const uint16_t capacity, const int journal_address);
+
+		static uint64_t cardId(const WiegandFormat::WiegandFormatType format, const uint32_t facility, const uint32_t card);
+		static uint64_t cardId(const WiegandCard & card);
+
+		void begin();
+		bool allowed(const uint64_t id);
+		bool allowed(const WiegandCard & card);
+		bool add(const uint64_t id);
+		bool remove(const uint64_t id);
+		void clear();
+};
+#endif
+#endif
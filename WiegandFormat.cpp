@@ -0,0 +1,112 @@
+#include "WiegandFormat.h"
+#include "Wiegand.h"
+
+// parity checks, numbered by their bit in parity word
+// 0	H10301 even, bits 0-12
+// 1	H10301 odd, bits 13-25
+// 2	H10306 even, bits 0-16
+// 3	H10306 odd, bits 17-33
+// 4	Corporate1000 odd, bits 0-34
+// 5	Corporate1000 even, bit 1 and bits 2-33 except 4, 7, 10 ... 31
+// 6	Corporate1000 odd, bit 34 and bits 1-32 except 3, 6, 9 ... 30
+// 7	C15001 even, bits 0-17
+// 8	C15001 odd, bits 18-35
+// 9	H10304 even, bits 0-18
+// 10	H10304 odd, bits 18-36
+// 11-14	Keypad8 odd, bits n and n + 4 for n = 0-3 (upper nibble is complement of lower)
+const WiegandFormat::Format WiegandFormat::_formats[] PROGMEM =
+{
+	// bits	type			facility	card		parity mask		expected
+	{26,	H10301,			1,	8,		9,	16,		0x0003,			0x0002},
+	{34,	H10306,			1,	16,		17,	16,		0x000C,			0x0008},
+	{35,	Corporate1000,	2,	12,		14,	20,		0x0070,			0x0050},
+	{36,	C15001,			9,	10,		19,	16,		0x0180,			0x0100},
+	{37,	H10304,			1,	16,		17,	19,		0x0600,			0x0400},
+	{4,		Keypad4,		0,	0,		0,	4,		0x0000,			0x0000},
+	{8,		Keypad8,		0,	0,		4,	4,		0x7800,			0x7800},
+};
+
+// parity checks each bit position takes part in, derived from the list above
+const uint16_t WiegandFormat::_parity_columns[WIEGAND_PARITY_POSITIONS] PROGMEM =
+{
+	0x0A95, 0x12F5, 0x22F5, 0x42B5, 0x0AD5, 0x12F5, 0x22B5, 0x42D5,
+	0x02F5, 0x02B5, 0x02D5, 0x02F5, 0x02B5, 0x02D6, 0x02F6, 0x02B6,
+	0x02D6, 0x02FA, 0x073A, 0x055A, 0x057A, 0x053A, 0x055A, 0x057A,
+	0x053A, 0x055A, 0x0578, 0x0538, 0x0558, 0x0578, 0x0538, 0x0558,
+	0x0578, 0x0538, 0x0550, 0x0500, 0x0400
+};
+
+// copies description of format with given length from PROGMEM
+// returns false if there is no such format
+bool WiegandFormat::findFormat(const uint8_t bit_count, Format & format)
+{
+	for (uint8_t i = 0; i < sizeof(_formats) / sizeof(_formats[0]); i++)
+	{
+		if (pgm_read_byte(&_formats[i].bits) == bit_count)
+		{
+			memcpy_P(&format, &_formats[i], sizeof(Format));
+			return true;
+		}
+	}
+	return false;
+}
+
+// returns bits first to first + bits - 1 of message as a number
+// rcv_buffer holds last received bit in LSB of rcv_buffer[0]
+uint32_t WiegandFormat::extract(const uint8_t bit_count, const uint8_t * rcv_buffer, uint8_t first, uint8_t bits)
+{
+	uint32_t value = 0;
+	for (uint8_t pos = bit_count - 1 - first; bits > 0; bits--, pos--)
+	{
+		value = (value << 1) | ((rcv_buffer[pos >> 3] >> (pos & 7)) & 1);
+	}
+	return value;
+}
+
+// returns format of message with given length, or Unknown
+WiegandFormat::WiegandFormatType WiegandFormat::find(const uint8_t bit_count)
+{
+	Format format;
+	if (!findFormat(bit_count, format))
+	{
+		return Unknown;
+	}
+	return (WiegandFormatType)format.type;
+}
+
+// returns false if message has length of a known format, but its parity is wrong
+bool WiegandFormat::checkParity(const uint8_t bit_count, const uint16_t parity)
+{
+	Format format;
+	if (!findFormat(bit_count, format))
+	{
+		return true;
+	}
+	return (parity & format.parity_mask) == format.parity_expected;
+}
+
+// decodes message into card
+// returns false if message length doesn't match any known format
+bool WiegandFormat::decode(const uint8_t bit_count, const uint8_t * rcv_buffer, const uint16_t parity, WiegandCard & card)
+{
+	Format format;
+	if (!findFormat(bit_count, format))
+	{
+		card.format = Unknown;
+		card.facility = 0;
+		card.card = 0;
+		card.parity_ok = false;
+		return false;
+	}
+
+	card.format = (WiegandFormatType)format.type;
+	card.facility = extract(bit_count, rcv_buffer, format.facility_first, format.facility_bits);
+	card.card = extract(bit_count, rcv_buffer, format.card_first, format.card_bits);
+	card.parity_ok = (parity & format.parity_mask) == format.parity_expected;
+	return true;
+}
+
+bool WiegandFormat::decode(const WiegandMessage & message, WiegandCard & card)
+{
+	return decode(message.bit_count, message.rcv_buffer, message.parity, card);
+}
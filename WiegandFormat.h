@@ -0,0 +1,109 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * CARD FORMATS
+ *
+ * Decoder for standard card and keypad formats. Formats are described by a table in PROGMEM and
+ * are recognized by message length. Supported formats are:
+ *   H10301			26 bits, 8 bit facility code, 16 bit card number
+ *   H10306			34 bits, 16 bit facility code, 16 bit card number
+ *   Corporate1000	35 bits, 12 bit facility code, 20 bit card number
+ *   C15001			36 bits, 10 bit facility code, 16 bit card number (OEM code is ignored)
+ *   H10304			37 bits, 16 bit facility code, 19 bit card number
+ *   Keypad4		4 bits, key code in card number
+ *   Keypad8		8 bits, key code in card number, upper nibble is complement of lower
+ * Parity of all formats is computed incrementally while bits are received. Every parity check
+ * of every format has one bit in a 16 bit parity word, and each received one toggles the checks
+ * its position takes part in, which is a single table lookup per bit. When message is completed
+ * its parity is verified by comparing the parity word against format's expected value.
+ * Bit positions used in this file are counted from first received bit, starting with 0.
+ *
+ */
+
+
+#ifndef WiegandFormat_h_
+#define WiegandFormat_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+#if defined(__AVR__)
+	#include <avr/pgmspace.h>
+#elif !defined(PROGMEM)
+	// other targets, including host builds, keep tables in ordinary memory
+	#define PROGMEM
+	#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+	#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+	#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+	#define memcpy_P memcpy
+#endif
+
+// enums are stored in one byte where compiler allows it
+#if __cplusplus >= 201103L
+	#define WIEGAND_ENUM_BYTE : uint8_t
+#else
+	#define WIEGAND_ENUM_BYTE
+#endif
+
+#define WIEGAND_PARITY_POSITIONS 37		// number of bit positions covered by parity table (do not change)
+
+struct WiegandMessage;
+struct WiegandCard;
+
+class WiegandFormat
+{
+	public:
+		enum WiegandFormatType WIEGAND_ENUM_BYTE {Unknown, H10301, H10306, Corporate1000, C15001, H10304, Keypad4, Keypad8};
+
+	private:
+		// format description as stored in PROGMEM
+		struct Format
+		{
+			uint8_t bits;
+			uint8_t type;
+			uint8_t facility_first;
+			uint8_t facility_bits;
+			uint8_t card_first;
+			uint8_t card_bits;
+			uint16_t parity_mask;		// parity checks belonging to this format
+			uint16_t parity_expected;	// expected values of those checks, set for odd parity
+		};
+
+		static const Format _formats[] PROGMEM;
+		static const uint16_t _parity_columns[WIEGAND_PARITY_POSITIONS] PROGMEM;
+
+		static bool findFormat(const uint8_t bit_count, Format & format);
+		static uint32_t extract(const uint8_t bit_count, const uint8_t * rcv_buffer, uint8_t first, uint8_t bits);
+
+	public:
+		// returns parity checks toggled by a one received at position pos, for use by ISR
+		static inline uint16_t parityColumn(const uint8_t pos)
+		{
+			return pos < WIEGAND_PARITY_POSITIONS ? pgm_read_word(&_parity_columns[pos]) : 0;
+		}
+
+		static WiegandFormatType find(const uint8_t bit_count);
+		static bool checkParity(const uint8_t bit_count, const uint16_t parity);
+		static bool decode(const uint8_t bit_count, const uint8_t * rcv_buffer, const uint16_t parity, WiegandCard & card);
+		static bool decode(const WiegandMessage & message, WiegandCard & card);
+};
+
+// decoded card or key press
+struct WiegandCard
+{
+	WiegandFormat::WiegandFormatType format;
+	uint32_t facility;
+	uint32_t card;
+	bool parity_ok;
+};
+#endif
@@ -0,0 +1,157 @@
+#include "Wiegand.h"
+
+#if WIEGAND_INTERRUPT_SLOTS > 255
+	#error WIEGAND_INTERRUPT_SLOTS must not be more than 255
+#endif
+
+WiegandReceiver * WiegandHal::_slots[WIEGAND_INTERRUPT_SLOTS];
+uint8_t WiegandHal::_meanings[(WIEGAND_INTERRUPT_SLOTS + 7) / 8];
+#if defined(WIEGAND_HAL_HOST)
+uint8_t WiegandHal::_enabled[(WIEGAND_INTERRUPT_SLOTS + 7) / 8];
+#endif
+
+// ISR of one registry slot
+template <uint8_t N> void WIEGAND_ISR_ATTR WiegandHal::isr()
+{
+	_slots[N]->readBit(_meanings[N >> 3] & (1 << (N & 7)));
+}
+
+// returns ISR of slot, chain of compares is unrolled at compile time
+template <> WiegandHal::Handler WiegandHal::handler<WIEGAND_INTERRUPT_SLOTS>(const uint8_t)
+{
+	return NULL;
+}
+
+template <uint8_t N> WiegandHal::Handler WiegandHal::handler(const uint8_t slot)
+{
+	return slot == N ? &isr<N> : handler<N + 1>(slot);
+}
+
+// returns registry slot of pin, or -1 if pin can't interrupt
+int16_t WiegandHal::slot(const uint8_t pin)
+{
+#if defined(WIEGAND_HAL_AVR) && defined(WIEGAND_DIRECT_ISR_ONLY)
+	// WiegandDirect installs its own vectors, so no pin is left for attachInterrupt
+	(void)pin;
+	return -1;
+#else
+#if defined(WIEGAND_HAL_HOST)
+	int16_t slot = pin;
+#else
+	int16_t slot = digitalPinToInterrupt(pin);
+#endif
+	return slot >= 0 && slot < WIEGAND_INTERRUPT_SLOTS ? slot : -1;
+#endif
+}
+
+// registers pin of instance and starts handling its falling edges
+// called with interrupts disabled, returns false if pin can't be used or is already used
+bool WiegandHal::attach(const uint8_t pin, WiegandReceiver * instance, const bool meaning)
+{
+	int16_t n = slot(pin);
+	if (n < 0 || _slots[n] != NULL)
+	{
+		return false;
+	}
+
+	_slots[n] = instance;
+	if (meaning)
+		_meanings[n >> 3] |= 1 << (n & 7);
+	else
+		_meanings[n >> 3] &= ~(1 << (n & 7));
+
+#if defined(WIEGAND_HAL_HOST)
+	_enabled[n >> 3] |= 1 << (n & 7);
+#elif !defined(WIEGAND_DIRECT_ISR_ONLY)
+	attachInterrupt(n, handler<0>(n), FALLING);
+#endif
+
+#if defined(WIEGAND_HAL_AVR)
+	// Arduino seems to ignore Atmel datasheet regarding correct way to attach external interrupts
+	// and triggers ISR on attach, so interrupt flag is cleared manually
+	EIFR = _BV(pinToInterrupt(pin));
+#endif
+	return true;
+}
+
+// stops handling edges of registered pin and frees its slot
+// called with interrupts disabled
+void WiegandHal::detach(const uint8_t pin)
+{
+	int16_t n = slot(pin);
+	if (n < 0 || _slots[n] == NULL)
+	{
+		return;
+	}
+
+#if defined(WIEGAND_HAL_HOST)
+	_enabled[n >> 3] &= ~(1 << (n & 7));
+#elif !defined(WIEGAND_DIRECT_ISR_ONLY)
+	detachInterrupt(n);
+#endif
+	_slots[n] = NULL;
+}
+
+// enables or disables interrupt of registered pin, edges seen while disabled are ignored
+// on AVR it works on any external interrupt pin, so WiegandDirect uses it as well
+void WiegandHal::enable(const uint8_t pin, const bool enable)
+{
+#if defined(WIEGAND_HAL_AVR)
+	int8_t n = pinToInterrupt(pin);
+	if (n < 0)
+	{
+		return;
+	}
+
+	if (enable)
+	{
+		EIFR = _BV(n);
+		EIMSK |= _BV(n);
+	}
+	else
+	{
+		EIMSK &= ~_BV(n);
+	}
+#else
+	int16_t n = slot(pin);
+	if (n < 0 || _slots[n] == NULL)
+	{
+		return;
+	}
+
+#if defined(WIEGAND_HAL_HOST)
+	if (enable)
+		_enabled[n >> 3] |= 1 << (n & 7);
+	else
+		_enabled[n >> 3] &= ~(1 << (n & 7));
+#else
+	if (enable)
+		attachInterrupt(n, handler<0>(n), FALLING);
+	else
+		detachInterrupt(n);
+#endif
+#endif
+}
+
+// sets input to read level of pin
+void WiegandHal::input(const uint8_t pin, Input & input)
+{
+#if defined(WIEGAND_HAL_DIGITAL_READ)
+	input.pin = pin;
+#else
+	input.port = portInputRegister(digitalPinToPort(pin));
+	input.mask = digitalPinToBitMask(pin);
+#endif
+}
+
+#if defined(WIEGAND_HAL_HOST)
+// passes falling edge of pin to its instance, as its ISR would
+void WiegandHal::edge(const uint8_t pin)
+{
+	int16_t n = slot(pin);
+	if (n >= 0 && _slots[n] != NULL && (_enabled[n >> 3] & (1 << (n & 7))))
+	{
+		_slots[n]->readBit(_meanings[n >> 3] & (1 << (n & 7)));
+	}
+}
+#endif
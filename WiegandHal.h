@@ -0,0 +1,165 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * EDGE SOURCE
+ *
+ * Class WiegandHal is the only part of the receiver which knows how falling edges of DATA0 and
+ * DATA1 pins become interrupts. Decoder core (Wiegand::readBit and everything after it) is the
+ * same on every target. One backend is selected at compile time:
+ *   AVR		Uno (ATmega328P/168), Mega (ATmega1280/2560) and Leonardo (ATmega32U4). Edges come
+ *				through attachInterrupt, suspend and resume write EIMSK directly and clear the
+ *				pending flag, so edges seen while suspended don't show up on resume.
+ *   generic	every other board (SAMD, ESP32, ESP8266, RP2040, STM32, other AVRs, ...), any pin
+ *				for which digitalPinToInterrupt returns an interrupt can be used. Suspend and
+ *				resume detach and attach the interrupt again.
+ *   host		selected by defining WIEGAND_HAL_HOST when the library is built on a PC. Nothing
+ *				is attached, edges are fed by calling WiegandHal::edge with the pin number.
+ * Registry has one slot per interrupt number (pin number on host), which holds the instance and
+ * meaning (DATA0 or DATA1) of the pin using it. Slot is taken in Wiegand::begin, and released again
+ * if begin fails on the other pin. Pin whose slot is taken or out of range can't be used. Arduino
+ * ISRs take no argument, so each slot has its own small ISR, generated from a template, which loads
+ * the instance from its slot and calls Wiegand::readBit. It is the same work the fixed isrN
+ * routines used to do.
+ * Number of slots is WIEGAND_INTERRUPT_SLOTS: number of external interrupts on AVR (2, 6 and 5),
+ * NUM_DIGITAL_PINS on generic boards and 64 on host. It can be lowered in Wiegand.h to save RAM
+ * when only low interrupt numbers are used. Registry takes a pointer per slot, plus one byte per
+ * 8 slots for meanings (and the same again for enabled pins on host).
+ * On ESP32 and ESP8266 ISRs and the decoder functions they call are placed in IRAM
+ * (WIEGAND_ISR_ATTR), as those cores require for interrupt handlers.
+ * WiegandHal::Input lets ISR read level of a line (for WIEGAND_MIN_PULSE_WIDTH) without
+ * digitalRead. It holds input register and mask of the pin in the types of the board core, so
+ * 32 bit ports of SAMD, ESP32 and others are read whole. On host, on cores without
+ * portInputRegister and on compilers older than C++11 it holds the pin and reads it with
+ * digitalRead instead.
+ * Pin change interrupts (WIEGAND_PCINT) are AVR specific and stay in Wiegand.
+ *
+ */
+
+
+#ifndef WiegandHal_h_
+#define WiegandHal_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+#if defined(WIEGAND_HAL_HOST)
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega1280__) \
+	|| defined(__AVR_ATmega2560__) || defined(__AVR_ATmega32U4__)
+	#define WIEGAND_HAL_AVR
+#else
+	#define WIEGAND_HAL_GENERIC
+#endif
+
+#if defined(WIEGAND_INTERRUPT_SLOTS)
+#elif defined(WIEGAND_HAL_HOST)
+	#define WIEGAND_INTERRUPT_SLOTS 64
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+	#define WIEGAND_INTERRUPT_SLOTS 6
+#elif defined(__AVR_ATmega32U4__)
+	#define WIEGAND_INTERRUPT_SLOTS 5
+#elif defined(WIEGAND_HAL_AVR)
+	#define WIEGAND_INTERRUPT_SLOTS 2
+#elif defined(NUM_DIGITAL_PINS)
+	#define WIEGAND_INTERRUPT_SLOTS NUM_DIGITAL_PINS
+#else
+	#define WIEGAND_INTERRUPT_SLOTS 32
+#endif
+
+// functions running in interrupt context must be in IRAM on Espressif chips
+#if defined(ESP32) || defined(ESP8266)
+	#define WIEGAND_ISR_ATTR IRAM_ATTR
+#else
+	#define WIEGAND_ISR_ATTR
+#endif
+
+// keeps compiler from moving memory accesses across accesses of indexes shared with ISRs
+#define WIEGAND_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+#if __cplusplus >= 201103L
+	#define WIEGAND_CONSTEXPR constexpr
+#else
+	#define WIEGAND_CONSTEXPR inline
+#endif
+
+#if defined(WIEGAND_HAL_AVR)
+#elif defined(WIEGAND_HAL_HOST) || !defined(portInputRegister) || __cplusplus < 201103L
+	#define WIEGAND_HAL_DIGITAL_READ
+#endif
+
+class WiegandReceiver;
+
+class WiegandHal
+{
+	public:
+		// level of one pin, as read by ISR
+		struct Input
+		{
+#if defined(WIEGAND_HAL_AVR)
+			volatile uint8_t * port;
+			uint8_t mask;
+#elif defined(WIEGAND_HAL_DIGITAL_READ)
+			uint8_t pin;
+#else
+			decltype(portInputRegister(0)) port;
+			uint32_t mask;
+#endif
+		};
+
+		// returns true if pin is high
+		static inline bool level(const Input & input)
+		{
+#if defined(WIEGAND_HAL_DIGITAL_READ)
+			return digitalRead(input.pin) == HIGH;
+#else
+			return *input.port & input.mask;
+#endif
+		}
+
+	private:
+		typedef void (*Handler)();
+
+		static WiegandReceiver * _slots[WIEGAND_INTERRUPT_SLOTS];
+		static uint8_t _meanings[(WIEGAND_INTERRUPT_SLOTS + 7) / 8];
+#if defined(WIEGAND_HAL_HOST)
+		static uint8_t _enabled[(WIEGAND_INTERRUPT_SLOTS + 7) / 8];
+#endif
+
+		static int16_t slot(const uint8_t pin);
+		template <uint8_t N> static void isr();
+		template <uint8_t N> static Handler handler(const uint8_t slot);
+
+	public:
+		static bool attach(const uint8_t pin, WiegandReceiver * instance, const bool meaning);
+		static void detach(const uint8_t pin);
+		static void enable(const uint8_t pin, const bool enable);
+		static void input(const uint8_t pin, Input & input);
+#if defined(WIEGAND_HAL_HOST)
+		static void edge(const uint8_t pin);
+#endif
+
+#if defined(WIEGAND_HAL_AVR)
+		// returns Atmel external interrupt number (INTn) for pin, or -1 if pin doesn't have one
+		static WIEGAND_CONSTEXPR int8_t pinToInterrupt(const uint8_t pin)
+		{
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+			return pin == 2 ? 0 : pin == 3 ? 1 : -1;
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+			return pin == 2 ? 4 : pin == 3 ? 5 : pin == 21 ? 0 : pin == 20 ? 1 : pin == 19 ? 2 : pin == 18 ? 3 : -1;
+#else
+			return pin == 3 ? 0 : pin == 2 ? 1 : pin == 0 ? 2 : pin == 1 ? 3 : pin == 7 ? 6 : -1;
+#endif
+		}
+#endif
+};
+#endif
@@ -0,0 +1,111 @@
+#include "WiegandHub.h"
+
+#if (WIEGAND_HUB_QUEUE_SIZE & (WIEGAND_HUB_QUEUE_SIZE - 1)) != 0 || WIEGAND_HUB_QUEUE_SIZE > 64
+	#error WIEGAND_HUB_QUEUE_SIZE must be a power of two and not more than 64
+#endif
+
+WiegandHub::WiegandHub()
+	:_bus_count(0), _event_head(0), _event_tail(0), _sequence(0) {}
+
+// registers bus, which must be initialized already
+// returns bus id, or -1 if there are too many buses
+int8_t WiegandHub::add(WiegandReceiver & bus)
+{
+	if (_bus_count >= WIEGAND_HUB_BUSES)
+	{
+		return -1;
+	}
+
+	_buses[_bus_count] = &bus;
+	return _bus_count++;
+}
+
+// takes completed messages of all buses into event queue
+// returns number of new events
+uint8_t WiegandHub::poll()
+{
+	uint32_t now = micros();
+	uint8_t first = _event_head;
+
+	for (uint8_t bus = 0; bus < _bus_count; bus++)
+	{
+		WiegandReceiver * instance = _buses[bus];
+		if (instance->_status == WiegandReceiver::Uninitialized)
+		{
+			continue;
+		}
+
+		// messages which don't fit stay in queue of their bus until next poll
+		WiegandMessage message;
+		while ((uint8_t)(_event_head - _event_tail) < WIEGAND_HUB_QUEUE_SIZE
+			&& instance->popMessage(message, now))
+		{
+			WiegandEvent & event = _events[_event_head & (WIEGAND_HUB_QUEUE_SIZE - 1)];
+			event.bus = bus;
+			event.message = message;
+#if defined(WIEGAND_MESSAGE_TIMING)
+			event.micros = message.end_micros;
+#else
+			event.micros = now;
+#endif
+
+			// insertion sort among events of this poll, older events were all received earlier
+			for (uint8_t i = _event_head; i != first; i--)
+			{
+				WiegandEvent & later = _events[i & (WIEGAND_HUB_QUEUE_SIZE - 1)];
+				WiegandEvent & earlier = _events[(uint8_t)(i - 1) & (WIEGAND_HUB_QUEUE_SIZE - 1)];
+				if ((int32_t)(later.micros - earlier.micros) >= 0)
+				{
+					break;
+				}
+				WiegandEvent swap = later;
+				later = earlier;
+				earlier = swap;
+			}
+			_event_head++;
+		}
+	}
+
+	// sequence numbers follow final order
+	for (uint8_t i = first; i != _event_head; i++)
+	{
+		_events[i & (WIEGAND_HUB_QUEUE_SIZE - 1)].sequence = _sequence++;
+	}
+
+	return _event_head - first;
+}
+
+// returns number of events waiting in queue
+uint8_t WiegandHub::available()
+{
+	return _event_head - _event_tail;
+}
+
+// takes oldest event from queue
+// returns false if there are no events waiting
+bool WiegandHub::read(WiegandEvent & event)
+{
+	if (_event_head == _event_tail)
+	{
+		return false;
+	}
+
+	event = _events[_event_tail & (WIEGAND_HUB_QUEUE_SIZE - 1)];
+	_event_tail++;
+	return true;
+}
+
+#if defined(WIEGAND_STATS)
+// returns number of messages registered buses lost because their queues were full
+uint16_t WiegandHub::overruns()
+{
+	uint16_t overruns = 0;
+	WiegandStats stats;
+	for (uint8_t bus = 0; bus < _bus_count; bus++)
+	{
+		_buses[bus]->getStats(stats);
+		overruns += stats.overruns;
+	}
+	return overruns;
+}
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * HUB
+ *
+ * Class WiegandHub collects messages of several Wiegand instances (buses) into one event queue.
+ * Buses are registered with WiegandHub::add, which returns bus id (0, 1, ... in order of
+ * registration). WiegandHub::poll reads micros() once and takes all completed messages of all
+ * buses in one pass, using that time for timeout checks of every bus. New events are sorted by
+ * time of their last bit (end_micros) and numbered by a sequence number which grows by one with
+ * every event, so events of different buses come out of WiegandHub::read in the order they
+ * were received. Messages which complete later on have their last bit later than all messages
+ * taken earlier, unless buses use different timeouts (see WIEGAND_ADAPTIVE_TIMEOUT).
+ * Without WIEGAND_MESSAGE_TIMING there is no last bit time, so events are stamped with poll
+ * time and sorted by bus id within one poll.
+ * If event queue is full, poll stops taking messages, and the rest wait in queues of their buses
+ * until next poll, so hub loses nothing itself. WiegandHub::overruns returns messages the buses
+ * lost because their own queues were full (WIEGAND_STATS only).
+ * Hub is used from loop only. Buses shouldn't be read directly or have callbacks set while
+ * registered, since each message can be taken only once.
+ *
+ */
+
+
+#ifndef WiegandHub_h_
+#define WiegandHub_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+#include "Wiegand.h"
+
+#define WIEGAND_HUB_BUSES 6				// max number of registered buses
+#define WIEGAND_HUB_QUEUE_SIZE 8		// number of events that can be queued
+										// must be a power of two and not more than 64
+
+
+// message received on one of hub buses
+struct WiegandEvent
+{
+	uint8_t bus;
+	unsigned long sequence;
+	unsigned long micros;			// time of last bit, or of poll without WIEGAND_MESSAGE_TIMING
+	WiegandMessage message;
+};
+
+
+class WiegandHub
+{
+	private:
+		WiegandReceiver * _buses[WIEGAND_HUB_BUSES];
+		uint8_t _bus_count;
+
+		// event queue, used from loop only, both indexes run freely and wrap around
+		WiegandEvent _events[WIEGAND_HUB_QUEUE_SIZE];
+		uint8_t _event_head;
+		uint8_t _event_tail;
+
+		unsigned long _sequence;
+
+	public:
+		WiegandHub();
+
+		int8_t add(WiegandReceiver & bus);
+		uint8_t poll();
+		uint8_t available();
+		bool read(WiegandEvent & event);
+#if defined(WIEGAND_STATS)
+		uint16_t overruns();
+#endif
+};
+#endif
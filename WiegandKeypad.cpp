@@ -0,0 +1,97 @@
+#include "WiegandKeypad.h"
+#include "Wiegand.h"
+
+WiegandKeypad::WiegandKeypad()
+{
+	reset();
+}
+
+// drops credential being entered
+void WiegandKeypad::reset()
+{
+	_pending = false;
+	_complete = false;
+	credential.has_card = false;
+	credential.pin_length = 0;
+	credential.pin[0] = 0;
+}
+
+// decodes message and adds it to credential
+// returns true if credential is complete
+bool WiegandKeypad::feed(const WiegandMessage & message)
+{
+	WiegandCard card;
+	if (!WiegandFormat::decode(message, card))
+	{
+		return false;
+	}
+
+	return feed(card);
+}
+
+// adds decoded card or key to credential
+// returns true if credential is complete
+bool WiegandKeypad::feed(const WiegandCard & card)
+{
+	if (!card.parity_ok)
+	{
+		return false;
+	}
+
+	// previous credential was already handed over
+	if (_complete)
+	{
+		reset();
+	}
+
+	if (card.format != WiegandFormat::Keypad4 && card.format != WiegandFormat::Keypad8)
+	{
+		// card starts a new credential
+		reset();
+		credential.has_card = true;
+		credential.card = card;
+		_pending = true;
+	}
+	else if (card.card <= 9)
+	{
+		if (credential.pin_length < WIEGAND_PIN_LENGTH)
+		{
+			credential.pin[credential.pin_length++] = '0' + card.card;
+			credential.pin[credential.pin_length] = 0;
+		}
+		_pending = true;
+	}
+	else if (card.card == Clear)
+	{
+		// card read before stays, without it nothing is left to complete
+		credential.pin_length = 0;
+		credential.pin[0] = 0;
+		_pending = credential.has_card;
+	}
+	else if (card.card == Enter && _pending)
+	{
+		_pending = false;
+		_complete = true;
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+
+	_last_millis = millis();
+	return false;
+}
+
+// drops unfinished credential if nothing was fed for WIEGAND_PIN_TIMEOUT
+// returns true if it was dropped
+bool WiegandKeypad::timedOut()
+{
+	if (_pending && millis() - _last_millis > WIEGAND_PIN_TIMEOUT)
+	{
+		reset();
+		return true;
+	}
+
+	return false;
+}
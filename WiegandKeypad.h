@@ -0,0 +1,76 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * KEYPAD
+ *
+ * Card and PIN readers send every key press as a separate 4 bit (Keypad4) or 8 bit (Keypad8,
+ * upper nibble is complement of lower) message. Class WiegandKeypad collects them into a PIN and
+ * combines it with the card read before it into one WiegandCredential.
+ * Messages are given to WiegandKeypad::feed, which returns true when credential is complete.
+ * Keys 0-9 are appended to PIN, key 10 (*, ESC) clears PIN and key 11 (#, ENT) completes the
+ * credential, with or without a card, if anything was entered. After a clear, that is only the
+ * card read before it, so Enter right after Clear without a card is ignored. Card message starts a new
+ * credential and drops the unfinished one. Key messages which fail complement check, other keys
+ * and unknown formats are ignored. Digits beyond WIEGAND_PIN_LENGTH are ignored too.
+ * If no message arrives for WIEGAND_PIN_TIMEOUT milliseconds, unfinished credential is dropped.
+ * This is checked by WiegandKeypad::timedOut, which should be called from loop.
+ * Credential stays in WiegandKeypad::credential until next message is fed.
+ * Each key message still waits for message completion timeout of the receiver, defining
+ * WIEGAND_ADAPTIVE_TIMEOUT in Wiegand.h shortens it to a few bit intervals.
+ *
+ */
+
+
+#ifndef WiegandKeypad_h_
+#define WiegandKeypad_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+#include "WiegandFormat.h"
+
+#define WIEGAND_PIN_LENGTH 8			// max number of PIN digits
+#define WIEGAND_PIN_TIMEOUT 10000		// time in milliseconds after which unfinished PIN is dropped
+
+
+// card and PIN entered after it
+struct WiegandCredential
+{
+	bool has_card;
+	WiegandCard card;
+	uint8_t pin_length;
+	char pin[WIEGAND_PIN_LENGTH + 1];	// digits, zero terminated
+};
+
+
+class WiegandKeypad
+{
+	public:
+		enum WiegandKey {Clear = 10, Enter = 11};
+
+	private:
+		unsigned long _last_millis;
+		bool _pending;					// credential is being entered
+		bool _complete;					// credential was completed and not replaced yet
+
+	public:
+		WiegandCredential credential;
+
+		WiegandKeypad();
+
+		bool feed(const WiegandMessage & message);
+		bool feed(const WiegandCard & card);
+		bool timedOut();
+		void reset();
+};
+#endif
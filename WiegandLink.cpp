@@ -0,0 +1,124 @@
+#include "WiegandLink.h"
+
+#if (WIEGAND_LINK_BUFFER & (WIEGAND_LINK_BUFFER - 1)) != 0 || WIEGAND_LINK_BUFFER > 128
+	#error WIEGAND_LINK_BUFFER must be a power of two and not more than 128
+#endif
+#if WIEGAND_LINK_BUFFER < WIEGAND_LINK_MAX_RECORD
+	#error WIEGAND_LINK_BUFFER is too small for one record
+#endif
+
+WiegandLink::WiegandLink(Print & output)
+	:_output(output), _head(0), _tail(0), _dropped(0) {}
+
+// CRC-16/CCITT-FALSE update with one byte
+uint16_t WiegandLink::crc(uint16_t crc, const uint8_t value)
+{
+	crc ^= (uint16_t)value << 8;
+	for (uint8_t i = 0; i < 8; i++)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+// queues record of received message
+// returns false if record was dropped because buffer is full
+bool WiegandLink::send(const uint8_t bus, const WiegandMessage & message)
+{
+#if defined(WIEGAND_MESSAGE_TIMING)
+	return send(bus, Wiegand::Done, message.bit_count, message.rcv_buffer, message.total_micros);
+#else
+	return send(bus, Wiegand::Done, message.bit_count, message.rcv_buffer, 0);
+#endif
+}
+
+// queues record, payload may be NULL when bit_count is 0 (i.e. for Error status)
+// returns false if record was dropped because buffer is full
+bool WiegandLink::send(const uint8_t bus, const Wiegand::WiegandStatus status, const uint8_t bit_count,
+	const uint8_t * payload, const unsigned long duration)
+{
+	if (bit_count > WIEGAND_MAX_BITS)
+	{
+		return false;
+	}
+
+	uint8_t record[WIEGAND_LINK_MAX_RECORD - 2];
+	uint8_t length = 0;
+	record[length++] = bus;
+	record[length++] = status;
+	record[length++] = bit_count;
+	for (uint8_t i = 0; i < (bit_count + 7) / 8; i++)
+		record[length++] = payload[i];
+	for (uint8_t i = 0; i < 4; i++)
+		record[length++] = duration >> (i * 8);
+
+	uint16_t value = 0xFFFF;
+	for (uint8_t i = 0; i < length; i++)
+		value = crc(value, record[i]);
+	record[length++] = value;
+	record[length++] = value >> 8;
+
+	// COBS needs one byte more than record, plus the delimiter
+	if ((uint8_t)(WIEGAND_LINK_BUFFER - (uint8_t)(_head - _tail)) < length + 2)
+	{
+		_dropped++;
+		return false;
+	}
+
+	// each zero is replaced by distance to next one, first byte is distance to first zero, record
+	// is shorter than 254 bytes so no other code bytes are needed
+	uint8_t code = _head++;
+	uint8_t distance = 1;
+	for (uint8_t i = 0; i < length; i++)
+	{
+		if (record[i] == 0)
+		{
+			_buffer[code & (WIEGAND_LINK_BUFFER - 1)] = distance;
+			code = _head++;
+			distance = 1;
+		}
+		else
+		{
+			_buffer[_head++ & (WIEGAND_LINK_BUFFER - 1)] = record[i];
+			distance++;
+		}
+	}
+	_buffer[code & (WIEGAND_LINK_BUFFER - 1)] = distance;
+	_buffer[_head++ & (WIEGAND_LINK_BUFFER - 1)] = 0;
+
+	update();
+	return true;
+}
+
+// writes as much of buffer as output accepts without blocking
+void WiegandLink::update()
+{
+	while (_head != _tail)
+	{
+		uint8_t pending = _head - _tail;
+		uint8_t start = _tail & (WIEGAND_LINK_BUFFER - 1);
+
+		// one write per contiguous part of buffer
+		if (pending > WIEGAND_LINK_BUFFER - start)
+			pending = WIEGAND_LINK_BUFFER - start;
+
+		int room = _output.availableForWrite();
+		if (room <= 0)
+		{
+			return;
+		}
+		if (pending > room)
+			pending = room;
+
+		uint8_t written = _output.write(&_buffer[start], pending);
+		if (written == 0)
+		{
+			return;
+		}
+		_tail += written;
+	}
+}
+
+// returns number of records dropped because buffer was full
+uint16_t WiegandLink::dropped()
+{
+	return _dropped;
+}
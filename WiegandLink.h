@@ -0,0 +1,72 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * BINARY LINK
+ *
+ * Class WiegandLink forwards messages to a host as short binary records, instead of text
+ * printed by Wiegand::print. Record is (multibyte values are little endian):
+ *   bus			1 byte, bus id given by caller (i.e. WiegandEvent::bus)
+ *   status			1 byte, Wiegand::WiegandStatus, Done for messages
+ *   bit_count		1 byte
+ *   payload		(bit_count + 7) / 8 bytes of rcv_buffer, last bit in LSB of first byte
+ *   duration		4 bytes, total_micros, 0 without WIEGAND_MESSAGE_TIMING
+ *   crc			2 bytes, CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) of
+ *					all previous bytes
+ * Record is COBS encoded and followed by a zero byte, so host finds start of next record after
+ * any corruption by reading up to next zero. 26 bit message takes 15 bytes on the wire.
+ * Records are encoded into a WIEGAND_LINK_BUFFER bytes ring buffer and written from it by
+ * WiegandLink::update, which must be called from loop. It writes only as many bytes as output
+ * accepts without blocking (availableForWrite), in one write call. If buffer has no room for a
+ * record, it is dropped and counted by WiegandLink::dropped.
+ * Output must implement availableForWrite, as HardwareSerial and USB Serial do.
+ * Host side decoder is in extras/wiegand_link.py.
+ *
+ */
+
+
+#ifndef WiegandLink_h_
+#define WiegandLink_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+#include "Wiegand.h"
+
+#define WIEGAND_LINK_BUFFER 64			// size of transmit buffer, power of two, not more than 128
+										// max encoded record length (do not change)
+#define WIEGAND_LINK_MAX_RECORD (3 + WIEGAND_MAX_BYTES + 4 + 2 + 2)
+
+
+class WiegandLink
+{
+	private:
+		Print & _output;
+
+		// transmit buffer, both indexes run freely and wrap around
+		uint8_t _buffer[WIEGAND_LINK_BUFFER];
+		uint8_t _head;
+		uint8_t _tail;
+		uint16_t _dropped;
+
+		static uint16_t crc(uint16_t crc, const uint8_t value);
+
+	public:
+		WiegandLink(Print & output);
+
+		bool send(const uint8_t bus, const WiegandMessage & message);
+		bool send(const uint8_t bus, const Wiegand::WiegandStatus status, const uint8_t bit_count,
+			const uint8_t * payload, const unsigned long duration);
+		void update();
+		uint16_t dropped();
+};
+#endif
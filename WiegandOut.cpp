@@ -0,0 +1,212 @@
+#include "WiegandOut.h"
+
+#if (WIEGAND_OUT_QUEUE_SIZE & (WIEGAND_OUT_QUEUE_SIZE - 1)) != 0 || WIEGAND_OUT_QUEUE_SIZE > 64
+	#error WIEGAND_OUT_QUEUE_SIZE must be a power of two and not more than 64
+#endif
+#if WIEGAND_OUT_PULSE_WIDTH >= WIEGAND_OUT_BIT_INTERVAL
+	#error WIEGAND_OUT_PULSE_WIDTH must be shorter than WIEGAND_OUT_BIT_INTERVAL
+#endif
+
+// sent messages must be received correctly by Wiegand class with the same settings
+#if WIEGAND_OUT_BIT_INTERVAL >= WIEGAND_MAX_BIT_INTERVAL || WIEGAND_OUT_MESSAGE_GAP <= WIEGAND_MAX_BIT_INTERVAL
+	#error WIEGAND_OUT_BIT_INTERVAL and WIEGAND_OUT_MESSAGE_GAP do not fit WIEGAND_MAX_BIT_INTERVAL
+#endif
+#if defined(WIEGAND_MIN_BIT_INTERVAL) && WIEGAND_OUT_BIT_INTERVAL < WIEGAND_MIN_BIT_INTERVAL
+	#error WIEGAND_OUT_BIT_INTERVAL is shorter than WIEGAND_MIN_BIT_INTERVAL
+#endif
+#if defined(WIEGAND_MIN_PULSE_WIDTH) && WIEGAND_OUT_PULSE_WIDTH <= WIEGAND_MIN_PULSE_WIDTH
+	#error WIEGAND_OUT_PULSE_WIDTH is not longer than WIEGAND_MIN_PULSE_WIDTH
+#endif
+
+// Timer2 ticks per millisecond with 64 prescaler
+#define WIEGAND_OUT_TICKS_PER_MS (F_CPU / 64000UL)
+
+WiegandOut * WiegandOut::_instance = NULL;
+
+WiegandOut::WiegandOut(const byte data0_pin, const byte data1_pin)
+	:_data0_pin(data0_pin), _data1_pin(data1_pin), _data0_output(NULL), _data1_output(NULL),
+	_data0_mask(0), _data1_mask(0), _queue_head(0), _queue_tail(0), _running(false), _state(Idle),
+	_bit(0), _wait_ticks(0) {}
+
+// initializer, sets lines high and takes over Timer2
+// returns true if successfull, false otherwise
+bool WiegandOut::begin()
+{
+#if defined(TIMSK2)
+	// defined by WIEGAND_OUT_ISR, so sketch can't start the timer without its vector
+	installed();
+
+	// only one instance can use the timer
+	if (_instance != NULL)
+	{
+		return false;
+	}
+
+	_data0_output = portOutputRegister(digitalPinToPort(_data0_pin));
+	_data1_output = portOutputRegister(digitalPinToPort(_data1_pin));
+	_data0_mask = digitalPinToBitMask(_data0_pin);
+	_data1_mask = digitalPinToBitMask(_data1_pin);
+
+	digitalWrite(_data0_pin, HIGH);
+	digitalWrite(_data1_pin, HIGH);
+	pinMode(_data0_pin, OUTPUT);
+	pinMode(_data1_pin, OUTPUT);
+
+	// CTC mode, timer stays stopped until there is something to send
+	bitClear(TIMSK2, OCIE2A);
+	TCCR2B = 0;
+	TCCR2A = _BV(WGM21);
+
+	_instance = this;
+	return true;
+#else
+	return false;
+#endif
+}
+
+// queues message to be sent, last bit is in LSB of buffer[0] as in received messages
+// returns false if queue is full or message is too long
+bool WiegandOut::send(const uint8_t * buffer, const uint8_t bit_count)
+{
+	if (_instance != this || bit_count == 0 || bit_count > WIEGAND_MAX_BITS)
+	{
+		return false;
+	}
+
+	uint8_t head = _queue_head;
+	if ((uint8_t)(head - _queue_tail) >= WIEGAND_OUT_QUEUE_SIZE)
+	{
+		return false;
+	}
+
+	OutMessage & message = _queue[head & (WIEGAND_OUT_QUEUE_SIZE - 1)];
+	message.bit_count = bit_count;
+	for (uint8_t i = 0; i < (bit_count + 7) / 8; i++)
+		message.buffer[i] = buffer[i];
+
+	// message must be fully written before it becomes visible to ISR
+	WIEGAND_BARRIER();
+	_queue_head = head + 1;
+	WIEGAND_BARRIER();
+
+	// ISR clears _running only after it finds queue empty, and timer is stopped then,
+	// so if it is still set ISR will find this message
+	if (!_running)
+	{
+		_running = true;
+		wait(0);
+	}
+	return true;
+}
+
+bool WiegandOut::send(const WiegandMessage & message)
+{
+	return send(message.rcv_buffer, message.bit_count);
+}
+
+// returns number of messages waiting to be sent, including the one being sent
+uint8_t WiegandOut::pending()
+{
+	return (uint8_t)(_queue_head - _queue_tail);
+}
+
+// starts timer to call nextEvent after wait_micros, at least two ticks are waited so that
+// compare value is always ahead of the counter
+void WiegandOut::wait(const unsigned long wait_micros)
+{
+#if defined(TIMSK2)
+	_wait_ticks = wait_micros * WIEGAND_OUT_TICKS_PER_MS / 1000;
+	if (_wait_ticks < 2)
+		_wait_ticks = 2;
+
+	uint16_t ticks = _wait_ticks > 256 ? 200 : _wait_ticks;
+	_wait_ticks -= ticks;
+
+	TCCR2B = 0;
+	TCNT2 = 0;
+	OCR2A = ticks - 1;
+	bitSet(TIFR2, OCF2A);
+	bitSet(TIMSK2, OCIE2A);
+	TCCR2B = _BV(CS22);
+#else
+	(void)wait_micros;
+#endif
+}
+
+// called on every Timer2 compare match, long waits are split into several compares and
+// the last one is at least 57 ticks long
+void WiegandOut::timer()
+{
+	WiegandOut * instance = _instance;
+	if (instance->_wait_ticks == 0)
+	{
+		instance->nextEvent();
+		return;
+	}
+
+#if defined(TIMSK2)
+	uint16_t ticks = instance->_wait_ticks > 256 ? 200 : instance->_wait_ticks;
+	instance->_wait_ticks -= ticks;
+	OCR2A = ticks - 1;
+#endif
+}
+
+// moves the state machine to next pulse edge, called from timer ISR only
+void WiegandOut::nextEvent()
+{
+	OutMessage & message = _queue[_queue_tail & (WIEGAND_OUT_QUEUE_SIZE - 1)];
+
+	switch (_state)
+	{
+		// bit pulse ended, release the line
+		case Pulse:
+			*_data0_output |= _data0_mask;
+			*_data1_output |= _data1_mask;
+			_bit++;
+			if (_bit < message.bit_count)
+			{
+				_state = Interval;
+				wait(WIEGAND_OUT_BIT_INTERVAL - WIEGAND_OUT_PULSE_WIDTH);
+			}
+			else
+			{
+				_state = Gap;
+				wait(WIEGAND_OUT_MESSAGE_GAP);
+			}
+			return;
+
+		// message is done, slot can be reused
+		case Gap:
+			WIEGAND_BARRIER();
+			_queue_tail++;
+			_state = Idle;
+			// fall through
+
+		case Idle:
+			if (_queue_head == _queue_tail)
+			{
+#if defined(TIMSK2)
+				bitClear(TIMSK2, OCIE2A);
+				TCCR2B = 0;
+#endif
+				_running = false;
+				return;
+			}
+			_bit = 0;
+			// fall through
+
+		// start pulse of next bit, first bit of message is its highest one
+		case Interval:
+		{
+			OutMessage & next = _queue[_queue_tail & (WIEGAND_OUT_QUEUE_SIZE - 1)];
+			uint8_t pos = next.bit_count - 1 - _bit;
+			if (next.buffer[pos >> 3] & (1 << (pos & 7)))
+				*_data1_output &= ~_data1_mask;
+			else
+				*_data0_output &= ~_data0_mask;
+			_state = Pulse;
+			wait(WIEGAND_OUT_PULSE_WIDTH);
+			return;
+		}
+	}
+}
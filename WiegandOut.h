@@ -0,0 +1,116 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * TRANSMITTER
+ *
+ * Class WiegandOut sends messages to a Wiegand panel, so board can be used as a bridge or to
+ * forward translated messages. Messages are queued by WiegandOut::send and sent from Timer2
+ * compare interrupt, so neither loop nor receiving ISRs wait for them.
+ * Each bit is a WIEGAND_OUT_PULSE_WIDTH microseconds low pulse on DATA0 (zero) or DATA1 (one),
+ * bits start WIEGAND_OUT_BIT_INTERVAL microseconds apart, and a message is followed by
+ * WIEGAND_OUT_MESSAGE_GAP microseconds of silence, so that receiver completes it before next
+ * one starts. Defaults fit receiver settings in Wiegand.h, which is checked at compile time.
+ * Timer2 runs in CTC mode with 64 prescaler (4us at 16MHz) only while there is something to send.
+ * Waits longer than 256 timer ticks take several compares, so interrupt rate stays around one
+ * per millisecond between bits, each of them only a few instructions long.
+ * Messages use the same layout as received ones, last bit in LSB of first byte, so a received
+ * WiegandMessage can be forwarded as it is.
+ * Only one instance can be used, since there is only one Timer2. Timer2 is also used by tone(),
+ * so they can't be used together. Boards without Timer2 (i.e. Leonardo) are not supported.
+ * Timer2 compare vector is not taken by the library, so sketches which don't send keep it for
+ * tone(), IRremote or MsTimer2. Sketch using WiegandOut installs it once at file scope with
+ * WIEGAND_OUT_ISR(), otherwise WiegandOut::begin fails to link (undefined WiegandOut::installed).
+ * Lines are driven high when idle. If panel expects open collector outputs, use a transistor
+ * or a buffer on each line.
+ *
+ */
+
+
+#ifndef WiegandOut_h_
+#define WiegandOut_h_
+
+#if ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+#include "Wiegand.h"
+
+#define WIEGAND_OUT_PULSE_WIDTH 50		// length of bit pulse in microseconds
+#define WIEGAND_OUT_BIT_INTERVAL 2000	// time between starts of two bits in microseconds
+#define WIEGAND_OUT_MESSAGE_GAP (WIEGAND_MAX_BIT_INTERVAL + WIEGAND_OUT_BIT_INTERVAL)
+										// silence after each message in microseconds
+#define WIEGAND_OUT_QUEUE_SIZE 4		// number of messages waiting to be sent
+										// must be a power of two and not more than 64
+
+
+class WiegandOut
+{
+	private:
+		enum WiegandOutState {Idle, Pulse, Interval, Gap};
+
+		// message waiting to be sent, in receiver layout
+		struct OutMessage
+		{
+			uint8_t bit_count;
+			uint8_t buffer[WIEGAND_MAX_BYTES];
+		};
+
+		static WiegandOut * _instance;
+
+		void wait(const unsigned long wait_micros);
+		void nextEvent();
+		static void installed();
+
+	protected:
+		const byte _data0_pin;
+		const byte _data1_pin;
+
+		volatile uint8_t * _data0_output;
+		volatile uint8_t * _data1_output;
+		uint8_t _data0_mask;
+		uint8_t _data1_mask;
+
+		// message queue, _queue_head is written only by producer (send) and _queue_tail only by
+		// consumer (timer ISR), both run freely and wrap around
+		OutMessage _queue[WIEGAND_OUT_QUEUE_SIZE];
+		volatile uint8_t _queue_head;
+		volatile uint8_t _queue_tail;
+		volatile bool _running;			// timer is running, cleared by ISR when queue is empty
+
+		// state of message being sent, used by ISR only
+		WiegandOutState _state;
+		uint8_t _bit;
+		unsigned long _wait_ticks;
+
+	public:
+		WiegandOut(const byte data0_pin, const byte data1_pin);
+
+		bool begin();
+		bool send(const uint8_t * buffer, const uint8_t bit_count);
+		bool send(const WiegandMessage & message);
+		uint8_t pending();
+
+		// for use by timer ISR only
+		static void timer();
+};
+
+// installs Timer2 compare vector of WiegandOut, must be used once at file scope, i.e.
+// WiegandOut panel(4, 5);
+// WIEGAND_OUT_ISR()
+#if defined(TIMSK2)
+#define WIEGAND_OUT_ISR() \
+	ISR(TIMER2_COMPA_vect) {WiegandOut::timer();} \
+	void WiegandOut::installed() {}
+#else
+#define WIEGAND_OUT_ISR()
+#endif
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Forwards every message received from reader to a panel. Messages are sent by WiegandOut from
+ * Timer2 interrupt, so loop keeps receiving while previous message is still going out.
+*/
+
+#include "Wiegand.h"
+#include "WiegandOut.h"
+
+#define WIEGAND_DATA_0 2			// reader line pins
+#define WIEGAND_DATA_1 3
+#define PANEL_DATA_0 4				// panel line pins
+#define PANEL_DATA_1 5
+
+Wiegand wiegand(WIEGAND_DATA_0, WIEGAND_DATA_1);
+WiegandOut panel(PANEL_DATA_0, PANEL_DATA_1);
+WIEGAND_OUT_ISR()
+
+void setup()
+{
+
+	Serial.begin(115200);
+
+	if (wiegand.begin() && panel.begin())
+		Serial.println("Wiegand init successful");
+	else
+		Serial.println("Wiegand init failed");
+
+}
+
+void loop()
+{
+
+	WiegandMessage message;
+	if (wiegand.read(message))
+	{
+		if (!panel.send(message))
+			Serial.println("Panel queue full, message lost");
+	}
+
+}
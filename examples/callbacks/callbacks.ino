@@ -0,0 +1,56 @@
+/*
+ * Event driven variant of demo. Instead of polling Wiegand::finishRead, Wiegand::dispatch calls
+ * callbacks for completed messages. Define WIEGAND_TIMER0_TICK in Wiegand.h to have the library
+ * queue timed out messages from Timer0 interrupt, so dispatch finds them ready.
+*/
+
+#include "Wiegand.h"
+
+#define WIEGAND_DATA_0 2			// Wiegand line pins
+#define WIEGAND_DATA_1 3
+
+Wiegand wiegand(WIEGAND_DATA_0, WIEGAND_DATA_1);
+
+void onMessage(WiegandReceiver & wiegand, const WiegandMessage & message)
+{
+	Serial.print("Received ");
+	Serial.print(message.bit_count);
+	Serial.println(" bits");
+
+	WiegandCard card;
+	if (WiegandFormat::decode(message, card))
+	{
+		Serial.print("Facility ");
+		Serial.print(card.facility);
+		Serial.print(", card ");
+		Serial.println(card.card);
+	}
+}
+
+void onError(WiegandReceiver & wiegand)
+{
+	Serial.println("Wiegand error");
+}
+
+void setup()
+{
+
+	Serial.begin(115200);
+
+	wiegand.onMessage(onMessage);
+	wiegand.onError(onError);
+
+	if (wiegand.begin()) 
+		Serial.println("Wiegand init successful");
+	else
+		Serial.println("Wiegand init failed");
+
+}
+
+void loop()
+{
+
+	// calls callbacks only if something actually happened
+	Wiegand::dispatch();
+
+}
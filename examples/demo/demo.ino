@@ -33,18 +33,28 @@ void loop()
 		Serial.println("");
 		wiegand.print();
 
+		// messages of standard card formats can be decoded into facility code and card number
+		WiegandCard card;
+		if (wiegand.decode(card))
+		{
+			Serial.print("Facility ");
+			Serial.print(card.facility);
+			Serial.print(", card ");
+			Serial.println(card.card);
+		}
+
 
 		switch(wiegand.bit_count)
 		{
 			case 36 :      
-				// 36 bits is probably a card swipe, you can read message content like this
-				for (int i = 0; i < WIEGAND_MAX_BYTES; i++)
-					Serial.println(wiegand.rcv_buffer[i], HEX); 
+				// 36 bits is probably a card swipe, you can read any part of message like this
+				Serial.println(wiegand.frame().bits(1, 16), HEX);
+				Serial.println(wiegand.frame().bits(17, 18), HEX);
 				break;
 
 			case 8 : 
-				// 8 bits is probably a reader key press
-				switch(wiegand.rcv_buffer[0])
+				// 8 bits is probably a reader key press, key code is in last 4 bits
+				switch(wiegand.frame().bits<4, 4>())
 				{
 					// case: ...
 				}
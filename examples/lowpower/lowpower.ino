@@ -0,0 +1,56 @@
+/*
+ * Demo for battery powered readers. Define WIEGAND_SLEEP in Wiegand.h. Loop handles completed
+ * messages and then sleeps until next interrupt, so CPU runs only while bits arrive, for about a
+ * millisecond per Timer0 tick while a message is being received, and while a message is printed.
+ * Without WIEGAND_SLEEP Wiegand::sleep returns at once and the demo polls like the others.
+*/
+
+#include "Wiegand.h"
+
+#define WIEGAND_DATA_0 2			// Wiegand line pins
+#define WIEGAND_DATA_1 3
+
+Wiegand wiegand(WIEGAND_DATA_0, WIEGAND_DATA_1);
+
+void setup()
+{
+
+	Serial.begin(115200);
+
+	if (wiegand.begin()) 
+		Serial.println("Wiegand init successful");
+	else
+		Serial.println("Wiegand init failed");
+
+}
+
+void loop()
+{
+
+	if (wiegand.finishRead())
+	{
+		WiegandCard card;
+		if (wiegand.decode(card))
+		{
+			Serial.print("Facility ");
+			Serial.print(card.facility);
+			Serial.print(", card ");
+			Serial.println(card.card);
+		}
+		else
+		{
+			wiegand.print();
+		}
+
+		// let serial finish sending, its interrupts would wake CPU anyway
+		Serial.flush();
+		wiegand.clear();
+	}
+	else if (wiegand.status == Wiegand::Error)
+	{
+		wiegand.clear();
+	}
+
+	Wiegand::sleep();
+
+}
@@ -0,0 +1,210 @@
+/*
+ * Benchmark of the receiver, with Wiegand.h settings of the build. It runs on Uno, Mega and
+ * Leonardo boards and in simavr (see bench.py), and needs nothing connected to pins 2 and 3.
+ * Both pins are switched to outputs after Wiegand::begin. An external interrupt fires on a
+ * falling edge even when its pin is an output, so the sketch sends messages by writing the port.
+ * Timer1 runs with prescaler 1 as a cycle counter, read before and after each write. One
+ * count covers interrupt entry, Arduino dispatch, the slot ISR, Wiegand::readBit and return.
+ * The same writes with interrupts suspended are measured first and subtracted.
+ * Consumer calls are measured the same way. Results go to Serial (Serial1 on Leonardo, whose
+ * USB isn't simulated) as lines "bench <name> <cycles>", followed by "bench done". Then CPU
+ * sleeps with interrupts disabled, which ends simavr.
+ * ISR runs with interrupts disabled, so irq_off_max (the longest edge) is the longest time the
+ * receiver keeps other interrupts waiting.
+ * With WIEGAND_DIRECT_ISR_ONLY the sketch measures WiegandDirect instead, whose vectors call
+ * Wiegand::readBit without Arduino dispatch (bench.py builds both variants).
+*/
+
+#include "Wiegand.h"
+#include <avr/sleep.h>
+
+#if !defined(WIEGAND_HAL_AVR)
+	#error bench runs on Uno, Mega and Leonardo
+#endif
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	#error bench uses Timer1 as cycle counter, WIEGAND_TIMER1_TIMESTAMPS must not be defined
+#endif
+
+#if defined(__AVR_ATmega32U4__)
+	#define BenchSerial Serial1
+#else
+	#define BenchSerial Serial
+#endif
+
+#define WIEGAND_DATA_0 2			// Wiegand line pins, driven by the sketch
+#define WIEGAND_DATA_1 3
+
+// 26 bit cards with facility 1 and cards 2, 3 and 4, different so repeat filter keeps them
+#define BENCH_CARD_2 0x2020004UL
+#define BENCH_CARD_3 0x2020007UL
+#define BENCH_CARD_4 0x2020008UL
+#define BENCH_CARD_BITS 26
+
+#if defined(WIEGAND_DIRECT_ISR_ONLY)
+WiegandDirect<WIEGAND_DATA_0, WIEGAND_DATA_1> wiegand;
+// vectors of pins 2 and 3, see WiegandDirect in Wiegand.h
+#if defined(__AVR_ATmega32U4__)
+WIEGAND_DIRECT_ISR(wiegand, INT1_vect, INT0_vect)
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+WIEGAND_DIRECT_ISR(wiegand, INT4_vect, INT5_vect)
+#else
+WIEGAND_DIRECT_ISR(wiegand, INT0_vect, INT1_vect)
+#endif
+#else
+Wiegand wiegand(WIEGAND_DATA_0, WIEGAND_DATA_1);
+#endif
+
+volatile uint8_t * data_port[2];
+uint8_t data_mask[2];
+
+// cycles of a pulse with pin interrupts suspended
+uint16_t overhead;
+uint16_t irq_off_max;
+
+// pulls line low and high again, returns cycles from just before the low write to just after it,
+// which includes ISR if its interrupt is enabled
+uint16_t pulse(const uint8_t line)
+{
+	// Timer0 interrupts would be counted with the edge, they run after the pulse
+	uint8_t timer0 = TIMSK0;
+	TIMSK0 = 0;
+	uint16_t start = TCNT1;
+	*data_port[line] &= ~data_mask[line];
+	// interrupt flag is set a cycle or two after the write, ISR must not split the read below
+	__asm__ __volatile__ ("nop\n\tnop\n\tnop");
+	uint16_t end = TCNT1;
+	*data_port[line] |= data_mask[line];
+	TIMSK0 = timer0;
+	return end - start;
+}
+
+// returns cycles of ISR handling a falling edge of line
+uint16_t edge(const uint8_t line)
+{
+	uint16_t cycles = pulse(line) - overhead;
+	if (cycles > irq_off_max)
+		irq_off_max = cycles;
+	return cycles;
+}
+
+// sends message with 1ms bit interval, returns cycles of its first edge and sum of the others
+uint16_t sendMessage(const uint32_t value, const uint8_t bits, uint32_t & rest)
+{
+	uint16_t first = 0;
+	rest = 0;
+	for (int8_t i = bits - 1; i >= 0; i--)
+	{
+		uint16_t cycles = edge((value >> i) & 1);
+		if (i == bits - 1)
+			first = cycles;
+		else
+			rest += cycles;
+		delayMicroseconds(1000);
+	}
+	return first;
+}
+
+void report(const char * name, const uint32_t cycles)
+{
+	BenchSerial.print("bench ");
+	BenchSerial.print(name);
+	BenchSerial.print(' ');
+	BenchSerial.println(cycles);
+}
+
+// reports failure or end of benchmark
+void finish(const char * line)
+{
+	BenchSerial.println(line);
+	BenchSerial.flush();
+
+	// simavr quits when CPU sleeps with interrupts disabled
+	noInterrupts();
+	sleep_enable();
+	sleep_cpu();
+}
+
+void setup()
+{
+	BenchSerial.begin(115200);
+	if (!wiegand.begin())
+	{
+		finish("bench failed Wiegand::begin");
+		return;
+	}
+
+	// lines idle high
+	for (uint8_t line = 0; line < 2; line++)
+	{
+		uint8_t pin = line ? WIEGAND_DATA_1 : WIEGAND_DATA_0;
+		data_port[line] = portOutputRegister(digitalPinToPort(pin));
+		data_mask[line] = digitalPinToBitMask(pin);
+		digitalWrite(pin, HIGH);
+		pinMode(pin, OUTPUT);
+	}
+
+	// Timer1 counts cycles, nothing in the sketch lasts 65536 cycles
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+	TIMSK1 = 0;
+
+	wiegand.suspend();
+	overhead = pulse(0);
+	wiegand.resume();
+	BenchSerial.flush();
+
+	// message polled after it timed out
+	uint32_t rest;
+	uint16_t first = sendMessage(BENCH_CARD_2, BENCH_CARD_BITS, rest);
+	delayMicroseconds(WIEGAND_MAX_BIT_INTERVAL + 1000);
+
+	uint16_t start = TCNT1;
+	bool done = wiegand.finishRead();
+	uint16_t finish_read = TCNT1 - start;
+
+	WiegandCard card;
+	start = TCNT1;
+	bool decoded = wiegand.decode(card);
+	uint16_t decode = TCNT1 - start;
+
+	start = TCNT1;
+	wiegand.clear();
+	uint16_t clear = TCNT1 - start;
+
+	start = TCNT1;
+	wiegand.finishRead();
+	uint16_t finish_read_idle = TCNT1 - start;
+
+	// next message starts before previous one was polled, so first edge queues it
+	uint32_t ignored;
+	sendMessage(BENCH_CARD_3, BENCH_CARD_BITS, ignored);
+	delayMicroseconds(WIEGAND_MAX_BIT_INTERVAL + 1000);
+	uint16_t first_queueing = sendMessage(BENCH_CARD_4, BENCH_CARD_BITS, ignored);
+	delayMicroseconds(WIEGAND_MAX_BIT_INTERVAL + 1000);
+	uint8_t queued = 0;
+	while (wiegand.finishRead())
+	{
+		queued++;
+		wiegand.clear();
+	}
+
+	if (!done || !decoded || card.card != 2 || queued != 2)
+	{
+		finish("bench failed to receive messages");
+		return;
+	}
+
+	report("edge_first", first);
+	report("edge_bit", rest / (BENCH_CARD_BITS - 1));
+	report("edge_queueing", first_queueing);
+	report("irq_off_max", irq_off_max);
+	report("finish_read", finish_read);
+	report("finish_read_idle", finish_read_idle);
+	report("decode", decode);
+	report("clear", clear);
+	finish("bench done");
+}
+
+void loop()
+{
+}
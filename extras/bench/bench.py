@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+#
+# Wiegand protocol library for Arduino.
+# Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+#
+# This library is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+#
+# Builds bench.ino for each supported board with the library from this tree (its Wiegand.h
+# settings), once with Wiegand (attach variant) and once with WiegandDirect (direct variant),
+# runs it in simavr and reads cycle counts from its serial output. Flash and RAM of the sketch
+# are read with avr-size. Results are compared with baseline.json. The run fails when any value
+# grows more than the tolerance above its baseline. Values which have no baseline yet (first run,
+# new board, variant or value) are recorded into baseline.json and don't fail the run, so that
+# file is to be committed after such a run. --update overwrites all baselines with current results.
+#
+# Needs arduino-cli with the arduino:avr core, avr-size and simavr in PATH.
+#     python3 bench.py                    compare with baseline.json, record missing baselines
+#     python3 bench.py --update           write current results to baseline.json
+#     python3 bench.py --tolerance 10     allow 10% growth (default 5%)
+#     python3 bench.py --board uno        one board only
+#     python3 bench.py --variant direct   WiegandDirect only
+#
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+LIBRARY = os.path.dirname(os.path.dirname(HERE))
+BASELINE = os.path.join(HERE, 'baseline.json')
+
+# board name: (fully qualified board name, simavr MCU name)
+BOARDS = {
+    'uno': ('arduino:avr:uno', 'atmega328p'),
+    'mega': ('arduino:avr:mega:cpu=atmega2560', 'atmega2560'),
+    'leonardo': ('arduino:avr:leonardo', 'atmega32u4'),
+}
+
+# variant name: extra compiler flags
+VARIANTS = {
+    'attach': '',
+    'direct': '-DWIEGAND_DIRECT_ISR_ONLY',
+}
+
+BENCH_LINE = re.compile(r'bench (\w+) (\d+)')
+
+
+def build(board, variant):
+    """compiles the sketch, returns path of its ELF file"""
+    fqbn = BOARDS[board][0]
+    build_path = os.path.join(HERE, 'build', board, variant)
+    subprocess.run(['arduino-cli', 'compile', '--fqbn', fqbn, '--library', LIBRARY,
+        '--build-property', 'compiler.cpp.extra_flags=' + VARIANTS[variant],
+        '--build-path', build_path, HERE], check=True, stdout=subprocess.DEVNULL)
+    return os.path.join(build_path, 'bench.ino.elf')
+
+
+def size(elf):
+    """returns flash and RAM used by the sketch, from avr-size Berkeley output"""
+    output = subprocess.run(['avr-size', elf], check=True, stdout=subprocess.PIPE,
+        universal_newlines=True).stdout
+    text, data, bss = (int(field) for field in output.splitlines()[1].split()[:3])
+    return {'flash': text + data, 'ram': data + bss}
+
+
+def simulate(run, board, elf, timeout):
+    """runs the sketch in simavr, returns cycle counts it reported"""
+    mcu = BOARDS[board][1]
+    try:
+        process = subprocess.run(['simavr', '-m', mcu, '-f', '16000000', elf],
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True,
+            timeout=timeout)
+        output = process.stdout
+    except subprocess.TimeoutExpired as error:
+        output = error.stdout or ''
+        if isinstance(output, bytes):
+            output = output.decode(errors='replace')
+
+    results = {}
+    done = False
+    for line in output.splitlines():
+        if 'bench done' in line:
+            done = True
+        elif 'bench failed' in line:
+            raise RuntimeError('%s: %s' % (run, line.strip()))
+        match = BENCH_LINE.search(line)
+        if match:
+            results[match.group(1)] = int(match.group(2))
+
+    if not done:
+        raise RuntimeError('%s: simavr ended without "bench done"' % run)
+    return results
+
+
+def compare(results, baseline, tolerance):
+    """prints results next to baseline, returns number of regressions and values without baseline,
+    which are added to baseline"""
+    regressions = 0
+    missing = 0
+    for run, values in sorted(results.items()):
+        for name, value in sorted(values.items()):
+            base = baseline.get(run, {}).get(name)
+            if base is None:
+                note = 'recorded as baseline'
+                baseline.setdefault(run, {})[name] = value
+                missing += 1
+            elif value > base * (100 + tolerance) / 100:
+                note = 'REGRESSION, baseline %d' % base
+                regressions += 1
+            else:
+                note = 'baseline %d' % base
+            print('%-16s %-18s %7d  %s' % (run, name, value, note))
+    return regressions, missing
+
+
+def write_baseline(baseline):
+    """writes baseline.json, sorted so that changes are easy to review"""
+    with open(BASELINE, 'w') as target:
+        json.dump(baseline, target, indent=4, sort_keys=True)
+        target.write('\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='cycle and size benchmark in simavr')
+    parser.add_argument('--board', choices=sorted(BOARDS), action='append',
+        help='board to run, may be repeated (default all)')
+    parser.add_argument('--variant', choices=sorted(VARIANTS), action='append',
+        help='receiver variant to run, may be repeated (default all)')
+    parser.add_argument('--tolerance', type=float, default=5,
+        help='allowed growth over baseline in percent')
+    parser.add_argument('--timeout', type=float, default=60,
+        help='seconds simavr may run per board and variant')
+    parser.add_argument('--update', action='store_true',
+        help='write results to baseline.json instead of comparing')
+    args = parser.parse_args()
+
+    # results of each board and variant are kept under "board/variant"
+    results = {}
+    for board in args.board or sorted(BOARDS):
+        for variant in args.variant or sorted(VARIANTS):
+            run = '%s/%s' % (board, variant)
+            elf = build(board, variant)
+            results[run] = simulate(run, board, elf, args.timeout)
+            results[run].update(size(elf))
+
+    baseline = {}
+    if os.path.exists(BASELINE):
+        with open(BASELINE) as source:
+            baseline = json.load(source)
+
+    if args.update:
+        baseline.update(results)
+        write_baseline(baseline)
+        print('baseline written to %s' % BASELINE)
+        return 0
+
+    regressions, missing = compare(results, baseline, args.tolerance)
+    if missing:
+        write_baseline(baseline)
+        print('%d value(s) had no baseline and were recorded in %s, commit it'
+            % (missing, BASELINE))
+    if regressions:
+        print('%d value(s) grew more than %g%% over baseline' % (regressions, args.tolerance))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    try:
+        sys.exit(main())
+    except (RuntimeError, subprocess.CalledProcessError, OSError) as error:
+        print('bench: %s' % error, file=sys.stderr)
+        sys.exit(2)
@@ -0,0 +1,208 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * REPLAY
+ *
+ * Runs edges captured with WIEGAND_CAPTURE (Wiegand::dumpCapture output, lines
+ * "edge <line> <micros>", other lines are skipped) through the library decoder on a PC, with
+ * Wiegand.h settings of the build. Library is built with the host edge source (WIEGAND_HAL_HOST),
+ * receiver uses pin 0 for DATA0 and pin 1 for DATA1 and edges are fed with WiegandHal::edge.
+ * Arduino.h and the clock come from extras/test, time is taken from the trace and set with
+ * WiegandSim::setTime, so traces run as fast as they can be read. Before every edge
+ * the decoder is polled with finishRead at that edge's time, as if loop polled it all the time,
+ * and once more after the last edge when it timed out.
+ * Every message and error is printed, followed by statistics of each trace.
+ * In fuzz mode random edges with random intervals are fed to the decoder instead, and every
+ * message is checked for invariants which must hold for any input. Fuzz run starts just before
+ * micros() wraps at 32 bits, as traces which cross the wrap do.
+ *
+ * Build in extras/test, where make check also builds it and runs a short fuzz:
+ *     make replay
+ * Use:
+ *     ./replay trace.txt [trace.txt ...]		replay traces, - reads stdin
+ *     ./replay -f <edges> [seed]				fuzz
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Arduino.h"
+#include "Wiegand.h"
+#include "WiegandSim.h"
+
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	#error replay has no line levels, WIEGAND_MIN_PULSE_WIDTH must not be defined
+#endif
+#if !defined(WIEGAND_HAL_HOST)
+	#error replay must be built with WIEGAND_HAL_HOST
+#endif
+
+// one receiver for all traces, registry slots can't be released
+static Wiegand receiver(0, 1);
+
+// takes all messages completed by now, returns false if an invariant doesn't hold
+static bool drain(const bool quiet, unsigned long & messages, unsigned long & errors)
+{
+	while (receiver.finishRead())
+	{
+		messages++;
+		WiegandFrame frame = receiver.frame();
+		if (frame.bitCount() == 0 || frame.bitCount() > WIEGAND_MAX_BITS)
+		{
+			printf("%lu: invalid message length %u\n", (unsigned long)WiegandSim::now(), frame.bitCount());
+			return false;
+		}
+
+		if (!quiet)
+		{
+			printf("%lu: message %u bits %llX", (unsigned long)WiegandSim::now(), frame.bitCount(),
+				(unsigned long long)frame.toUint64());
+			WiegandCard card;
+			if (receiver.decode(card))
+				printf(" format %u facility %lu card %lu", card.format, (unsigned long)card.facility,
+					(unsigned long)card.card);
+			printf("\n");
+		}
+		receiver.clear();
+	}
+
+	if (receiver.status == Wiegand::Error)
+	{
+		errors++;
+		if (!quiet)
+			printf("%lu: error\n", (unsigned long)WiegandSim::now());
+		receiver.clear();
+	}
+	return true;
+}
+
+static void printStats(const unsigned long messages, const unsigned long errors)
+{
+	printf("%lu messages, %lu errors", messages, errors);
+#if defined(WIEGAND_STATS)
+	WiegandStats stats;
+	receiver.getStats(stats);
+	printf(", %lu bits, %u overruns, %u bit limit errors, %u parity errors", stats.bits,
+		stats.overruns, stats.bit_limit_errors, stats.parity_errors);
+#endif
+	printf("\n");
+}
+
+// starts next trace or fuzz run with empty receiver and zero statistics
+static void restart()
+{
+	// last message of previous run was completed, so time may start again from 0
+	WiegandSim::setTime(WiegandSim::now() + WIEGAND_MAX_BIT_INTERVAL + 1);
+	while (receiver.finishRead())
+		receiver.clear();
+	receiver.clear();
+#if defined(WIEGAND_STATS)
+	receiver.resetStats();
+#endif
+	WiegandSim::setTime(0);
+}
+
+static void replay(FILE * trace)
+{
+	unsigned long messages = 0;
+	unsigned long errors = 0;
+	char line[128];
+	unsigned int level;
+	unsigned long time;
+
+	restart();
+	while (fgets(line, sizeof(line), trace) != NULL)
+	{
+		if (sscanf(line, "edge %u %lu", &level, &time) != 2)
+		{
+			continue;
+		}
+
+		WiegandSim::setTime(time);
+		drain(false, messages, errors);
+		WiegandHal::edge(level != 0);
+	}
+
+	WiegandSim::setTime(WiegandSim::now() + WIEGAND_MAX_BIT_INTERVAL + 1);
+	drain(false, messages, errors);
+	printStats(messages, errors);
+}
+
+static bool fuzz(const unsigned long edges, unsigned long seed)
+{
+	unsigned long messages = 0;
+	unsigned long errors = 0;
+
+	// xorshift, so runs are repeatable on any platform
+	uint32_t state = seed ? seed : 1;
+	restart();
+
+	// run starts a second before micros() wraps, so messages across the wrap are checked too
+	WiegandSim::setTime(0xFFFFFFFFUL - 1000000);
+	for (unsigned long i = 0; i < edges; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		// mostly ordinary bit intervals, some glitches and some pauses between messages
+		uint32_t kind = state % 16;
+		uint32_t interval = (state >> 8) % (kind < 2 ? 100 : kind < 14 ? 3000 : 20000) + 1;
+
+		WiegandSim::setTime(WiegandSim::now() + interval);
+		if (!drain(true, messages, errors))
+		{
+			printf("invariant failed at edge %lu, seed %lu\n", i, seed);
+			return false;
+		}
+		WiegandHal::edge(state >> 31);
+	}
+
+	WiegandSim::setTime(WiegandSim::now() + WIEGAND_MAX_BIT_INTERVAL + 1);
+	if (!drain(true, messages, errors))
+	{
+		printf("invariant failed at end, seed %lu\n", seed);
+		return false;
+	}
+	printStats(messages, errors);
+	return true;
+}
+
+int main(int argc, char ** argv)
+{
+	receiver.begin();
+	if (argc >= 3 && strcmp(argv[1], "-f") == 0)
+	{
+		return fuzz(strtoul(argv[2], NULL, 10), argc > 3 ? strtoul(argv[3], NULL, 10) : 1) ? 0 : 1;
+	}
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s trace.txt [trace.txt ...] | -f <edges> [seed]\n", argv[0]);
+		return 2;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		FILE * trace = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+		if (trace == NULL)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+
+		printf("%s\n", argv[i]);
+		replay(trace);
+		if (trace != stdin)
+			fclose(trace);
+	}
+	return 0;
+}
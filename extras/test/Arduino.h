@@ -0,0 +1,169 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * Replacement Arduino.h for tests and benchmark on a PC. Time, line levels and interrupts are
+ * simulated by WiegandSim (see WiegandSim.h): micros() returns simulated time, which wraps at 32
+ * bits as on Arduino boards, digitalRead returns simulated line level, and noInterrupts and
+ * interrupts mask and unmask the simulated interrupt controller. Library is built with the host
+ * edge source of WiegandHal, so nothing is attached to real interrupts. Timer1 count and overflow
+ * flag follow simulated time, so WIEGAND_TIMER1_TIMESTAMPS can be tested as well. Timer2 registers
+ * and output ports are plain variables, so WiegandOut can be driven by calling its compare ISR.
+ * EEPROM is kept in memory and counts bytes read and written, EEPROM.h only includes this file.
+ *
+ */
+
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// library headers check ARDUINO before including this file, so it must be given to compiler
+#if !defined(ARDUINO)
+	#define ARDUINO 10800
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define FALLING 2
+#define DEC 10
+#define HEX 16
+
+#if !defined(F_CPU)
+	#define F_CPU 16000000UL
+#endif
+
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define _BV(bit) (1 << (bit))
+
+unsigned long micros();
+unsigned long millis();
+void noInterrupts();
+void interrupts();
+int digitalRead(uint8_t pin);
+inline void pinMode(uint8_t, uint8_t) {}
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void detachInterrupt(uint8_t) {}
+
+// minimal Print writing to stdout, used by Wiegand::print and Wiegand::dumpCapture, buffer write
+// and availableForWrite are as in Arduino core, used by WiegandLink
+class Print
+{
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t value) {return fputc(value, stdout) == EOF ? 0 : 1;}
+		virtual size_t write(const uint8_t * buffer, size_t size)
+		{
+			size_t written = 0;
+			while (written < size && write(buffer[written]))
+				written++;
+			return written;
+		}
+		virtual int availableForWrite() {return 0;}
+		size_t print(const char * text) {return fputs(text, stdout) < 0 ? 0 : strlen(text);}
+		size_t print(char value) {return write(value);}
+		size_t print(unsigned long value, int base = DEC) {return printf(base == HEX ? "%lX" : "%lu", value);}
+		size_t print(long value, int base = DEC) {return base == HEX ? print((unsigned long)value, base) : printf("%ld", value);}
+		size_t print(unsigned int value, int base = DEC) {return print((unsigned long)value, base);}
+		size_t print(int value, int base = DEC) {return print((long)value, base);}
+		size_t print(uint8_t value, int base = DEC) {return print((unsigned long)value, base);}
+		size_t println() {return print("\n");}
+		template <class T> size_t println(T value) {return print(value) + println();}
+		template <class T> size_t println(T value, int base) {return print(value, base) + println();}
+};
+
+extern Print Serial;
+
+// Timer1 registers used by WIEGAND_TIMER1_TIMESTAMPS, count follows simulated time with
+// prescaler 8 and overflow flag is set when it wraps, writing a one to TIFR1 clears the flag
+#define TOV1 0
+#define CS11 1
+#define TCNT1 timer1Count()
+
+struct Timer1Flags
+{
+	operator uint8_t() const;
+	Timer1Flags & operator=(const uint8_t value);
+};
+
+uint16_t timer1Count();
+extern uint8_t TCCR1A;
+extern uint8_t TCCR1B;
+extern uint8_t TIMSK1;
+extern Timer1Flags TIFR1;
+
+// output ports of 8 pins each, driven by digitalWrite and by WiegandOut directly, they don't
+// change simulated line levels
+#define digitalPinToPort(pin) ((pin) >> 3)
+#define digitalPinToBitMask(pin) (1 << ((pin) & 7))
+#define portOutputRegister(port) (&output_ports[port])
+extern volatile uint8_t output_ports[8];
+
+inline void digitalWrite(uint8_t pin, uint8_t value)
+{
+	if (value == LOW)
+		*portOutputRegister(digitalPinToPort(pin)) &= ~digitalPinToBitMask(pin);
+	else
+		*portOutputRegister(digitalPinToPort(pin)) |= digitalPinToBitMask(pin);
+}
+
+// Timer2 registers used by WiegandOut, the test calls compare ISR itself
+#define ISR(vector) void vector()
+#define WGM21 1
+#define CS22 2
+#define OCIE2A 1
+#define OCF2A 1
+extern uint8_t TCCR2A;
+extern uint8_t TCCR2B;
+extern uint8_t TCNT2;
+extern uint8_t OCR2A;
+extern uint8_t TIMSK2;
+extern uint8_t TIFR2;
+#define TIMSK2 TIMSK2					// library checks for Timer2 with defined(TIMSK2), as on AVR
+
+// 1 KB of EEPROM as on ATmega328, erased to 0xFF, counts bytes read and written since reset
+class EEPROMClass
+{
+	public:
+		uint8_t memory[1024];
+		unsigned long reads;
+		unsigned long writes;
+
+		EEPROMClass() {reset();}
+		void reset() {memset(memory, 0xFF, sizeof(memory)); reads = 0; writes = 0;}
+		uint8_t read(int address) {reads++; return memory[address];}
+		void write(int address, uint8_t value) {memory[address] = value; writes++;}
+		template <class T> T & get(int address, T & value)
+		{
+			memcpy(&value, &memory[address], sizeof(T));
+			reads += sizeof(T);
+			return value;
+		}
+		template <class T> const T & put(int address, const T & value)
+		{
+			memcpy(&memory[address], &value, sizeof(T));
+			writes += sizeof(T);
+			return value;
+		}
+		uint16_t length() {return sizeof(memory);}
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,261 @@
+#include "Wiegand.h"
+#include "WiegandSim.h"
+
+std::multimap<uint64_t, WiegandSim::Edge> WiegandSim::_schedule;
+uint64_t WiegandSim::_now;
+uint64_t WiegandSim::_levels = ~(uint64_t)0;
+uint64_t WiegandSim::_pending;
+bool WiegandSim::_enabled = true;
+bool WiegandSim::_in_isr;
+uint8_t WiegandSim::_isr_reads;
+uint32_t WiegandSim::_random = 1;
+uint8_t WiegandSim::_hook_pin;
+bool WiegandSim::_hook;
+uint64_t WiegandSim::_timer1_cleared;
+
+Print Serial;
+EEPROMClass EEPROM;
+
+unsigned long micros()
+{
+	WiegandSim::micros();
+	return (uint32_t)WiegandSim::now();
+}
+
+unsigned long millis()
+{
+	return (uint32_t)(WiegandSim::now() / 1000);
+}
+
+void noInterrupts()
+{
+	WiegandSim::disableInterrupts();
+}
+
+void interrupts()
+{
+	WiegandSim::enableInterrupts();
+}
+
+volatile uint8_t output_ports[8];
+uint8_t TCCR2A;
+uint8_t TCCR2B;
+uint8_t TCNT2;
+uint8_t OCR2A;
+uint8_t TIMSK2;
+uint8_t TIFR2;
+
+uint8_t TCCR1A;
+uint8_t TCCR1B;
+uint8_t TIMSK1;
+Timer1Flags TIFR1;
+
+uint16_t timer1Count()
+{
+	WiegandSim::micros();
+	return (uint16_t)WiegandSim::timer1Ticks();
+}
+
+Timer1Flags::operator uint8_t() const
+{
+	return WiegandSim::timer1Overflowed() ? _BV(TOV1) : 0;
+}
+
+Timer1Flags & Timer1Flags::operator=(const uint8_t value)
+{
+	if (value & _BV(TOV1))
+		WiegandSim::clearTimer1Overflow();
+	return *this;
+}
+
+int digitalRead(uint8_t pin)
+{
+	return WiegandSim::level(pin) ? HIGH : LOW;
+}
+
+void WiegandSim::reset(const uint64_t time, const uint32_t seed)
+{
+	_schedule.clear();
+	_now = time;
+	_levels = ~(uint64_t)0;
+	_pending = 0;
+	_enabled = true;
+	_in_isr = false;
+	_random = seed ? seed : 1;
+	_hook = false;
+	clearTimer1Overflow();
+}
+
+void WiegandSim::setTime(const uint64_t time)
+{
+	_now = time;
+}
+
+// xorshift
+uint32_t WiegandSim::random()
+{
+	_random ^= _random << 13;
+	_random ^= _random >> 17;
+	_random ^= _random << 5;
+	return _random;
+}
+
+// runs ISR of pin as the interrupt controller would, with interrupts disabled
+void WiegandSim::isr(const uint8_t pin)
+{
+	_enabled = false;
+	_in_isr = true;
+	_isr_reads = 0;
+	WiegandHal::edge(pin);
+	_in_isr = false;
+	_enabled = true;
+}
+
+void WiegandSim::disableInterrupts()
+{
+	_enabled = false;
+}
+
+// pending interrupts run in order of pin number, as AVR serves lower vectors first
+void WiegandSim::enableInterrupts()
+{
+	if (_in_isr)
+	{
+		return;
+	}
+
+	_enabled = true;
+	while (_pending != 0 && _enabled)
+	{
+		uint8_t pin = 0;
+		while (!(_pending & ((uint64_t)1 << pin)))
+			pin++;
+		_pending &= ~((uint64_t)1 << pin);
+		isr(pin);
+	}
+}
+
+// falling edge of pin, its ISR runs now or when interrupts are enabled again
+void WiegandSim::fall(const uint8_t pin)
+{
+	if (_enabled && !_in_isr)
+		isr(pin);
+	else
+		_pending |= (uint64_t)1 << pin;
+}
+
+// starts 50us pulse of pin from next micros() call outside of ISR
+void WiegandSim::onMicros(const uint8_t pin)
+{
+	_hook_pin = pin;
+	_hook = true;
+}
+
+// ISR which waits on micros() would wait forever if time stood still, so every call after the
+// first one in an ISR takes a microsecond, and lines change meanwhile as scheduled
+void WiegandSim::micros()
+{
+	if (_in_isr && _isr_reads++ > 0)
+	{
+		_now++;
+		while (!_schedule.empty() && _schedule.begin()->first <= _now)
+		{
+			Edge edge = _schedule.begin()->second;
+			_schedule.erase(_schedule.begin());
+			apply(edge);
+		}
+	}
+	if (_hook && !_in_isr)
+	{
+		_hook = false;
+		Edge edge;
+		edge.pin = _hook_pin;
+		edge.level = HIGH;
+		_schedule.insert(std::make_pair(_now + 50, edge));
+		edge.level = LOW;
+		apply(edge);
+	}
+}
+
+void WiegandSim::apply(const Edge & edge)
+{
+	bool was_high = level(edge.pin);
+	if (edge.level)
+		_levels |= (uint64_t)1 << edge.pin;
+	else
+		_levels &= ~((uint64_t)1 << edge.pin);
+
+	if (was_high && !edge.level)
+	{
+		fall(edge.pin);
+	}
+}
+
+// returns time of last scheduled edge, or current time if schedule is empty
+uint64_t WiegandSim::end()
+{
+	return _schedule.empty() ? _now : (--_schedule.end())->first;
+}
+
+// schedules message bits, first bit comes timing.gap after end of schedule
+void WiegandSim::send(const uint8_t data0, const uint8_t data1, const uint64_t value,
+	const uint8_t bits, const WiegandTiming & timing)
+{
+	uint64_t at = end() + timing.gap;
+	for (int8_t i = bits - 1; i >= 0; i--)
+	{
+		pulse((value >> i) & 1 ? data1 : data0, at, timing.pulse_width);
+		int32_t jitter = timing.jitter ? (int32_t)(random() % (2 * timing.jitter + 1)) - timing.jitter : 0;
+		at += timing.interval + jitter;
+	}
+}
+
+// schedules line low at time at and high again width later
+void WiegandSim::pulse(const uint8_t pin, const uint64_t at, const uint16_t width)
+{
+	Edge edge;
+	edge.pin = pin;
+	edge.level = LOW;
+	_schedule.insert(std::make_pair(at, edge));
+	edge.level = HIGH;
+	_schedule.insert(std::make_pair(at + width, edge));
+}
+
+void WiegandSim::run(const uint64_t until, void (*poll)(), const uint32_t poll_period)
+{
+	uint64_t next_poll = poll_period ? _now + poll_period : 0;
+	while (!_schedule.empty() && _schedule.begin()->first <= until)
+	{
+		uint64_t at = _schedule.begin()->first;
+		while (poll_period && next_poll < at)
+		{
+			_now = next_poll;
+			poll();
+			next_poll += poll_period;
+		}
+
+		if (at > _now)
+			_now = at;
+		if (!poll_period && !_schedule.begin()->second.level)
+			poll();
+		Edge edge = _schedule.begin()->second;
+		_schedule.erase(_schedule.begin());
+		apply(edge);
+	}
+
+	while (poll_period && next_poll <= until)
+	{
+		_now = next_poll;
+		poll();
+		next_poll += poll_period;
+	}
+	if (_now < until)
+		_now = until;
+	if (!poll_period)
+		poll();
+}
+
+void WiegandSim::run(void (*poll)(), const uint32_t poll_period)
+{
+	run(end() + 2 * WIEGAND_MAX_BIT_INTERVAL, poll, poll_period);
+}
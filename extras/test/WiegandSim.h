@@ -0,0 +1,113 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * SIGNAL SIMULATOR
+ *
+ * Drives the library on a PC for tests and benchmark. It keeps simulated time, levels of pins
+ * and a simulated interrupt controller, and feeds falling edges to the library through the host
+ * edge source (WiegandHal::edge).
+ * Interrupt controller works like the one on AVR: a falling edge runs the ISR of its pin at once
+ * if interrupts are enabled, otherwise pin's flag is set and ISR runs when noInterrupts is undone
+ * by interrupts, lowest pin first. Several edges of one pin while interrupts are disabled leave
+ * one flag, so only one of them is seen. ISRs run with interrupts disabled. A pulse can also be
+ * started from the next micros() call of main loop code (WiegandSim::onMicros), so it lands right
+ * after the library sampled time in loop, where an ISR can hit on a board. Time stands still
+ * while an ISR runs, except that every micros() call after its first one takes a microsecond,
+ * so ISR waiting on micros() (WIEGAND_MIN_PULSE_WIDTH) sees lines change as scheduled. Reads of
+ * Timer1 count take time the same way.
+ * Edge generator schedules messages with given pulse width, bit interval, interval jitter and
+ * gap before the message, and single pulses (spikes) at any time. WiegandSim::run then plays
+ * the schedule in time order. It calls the poll function, standing in for loop, every
+ * poll_period microseconds of simulated time, or before every edge when poll_period is 0.
+ * Time runs in 64 bits, micros() returns its low 32 bits, as on a board, so micros() wrap is
+ * tested by starting near it (WiegandSim::setTime). Jitter comes from xorshift, so every run
+ * with the same seed is the same.
+ *
+ */
+
+
+#ifndef WiegandSim_h_
+#define WiegandSim_h_
+
+#include <stdint.h>
+#include <map>
+#include "Arduino.h"
+
+// timing of a generated message, all times in microseconds
+struct WiegandTiming
+{
+	uint16_t pulse_width;			// time line is held low
+	uint16_t interval;				// time from start of one bit to start of the next
+	uint16_t jitter;				// each interval is off by up to this much either way
+	uint32_t gap;					// quiet time from end of schedule to first bit
+
+	WiegandTiming(const uint16_t pulse_width = 50, const uint16_t interval = 2000,
+		const uint16_t jitter = 0, const uint32_t gap = 50000)
+		:pulse_width(pulse_width), interval(interval), jitter(jitter), gap(gap) {}
+};
+
+class WiegandSim
+{
+	private:
+		struct Edge
+		{
+			uint8_t pin;
+			bool level;
+		};
+
+		static std::multimap<uint64_t, Edge> _schedule;
+		static uint64_t _now;
+		static uint64_t _levels;		// one bit per pin, 1 is high
+		static uint64_t _pending;		// one interrupt flag per pin
+		static bool _enabled;
+		static bool _in_isr;
+		static uint8_t _isr_reads;		// micros() calls of running ISR
+		static uint32_t _random;
+		static uint8_t _hook_pin;
+		static bool _hook;
+		static uint64_t _timer1_cleared;	// Timer1 period in which overflow flag was cleared
+
+		static void isr(const uint8_t pin);
+		static void apply(const Edge & edge);
+
+	public:
+		// clears schedule, pending interrupts and hook, sets all pins high and time to time
+		static void reset(const uint64_t time = 0, const uint32_t seed = 1);
+		static void setTime(const uint64_t time);
+		static uint64_t now() {return _now;}
+		static uint32_t random();
+
+		// interrupt controller
+		static void disableInterrupts();
+		static void enableInterrupts();
+		static bool interruptsEnabled() {return _enabled;}
+		static void fall(const uint8_t pin);
+		static void onMicros(const uint8_t pin);
+		static void micros();
+		static bool level(const uint8_t pin) {return _levels & ((uint64_t)1 << pin);}
+
+		// Timer1, counts F_CPU / 8 ticks per second
+		static uint64_t timer1Ticks() {return _now * (F_CPU / 8000000UL);}
+		static bool timer1Overflowed() {return (timer1Ticks() >> 16) != _timer1_cleared;}
+		static void clearTimer1Overflow() {_timer1_cleared = timer1Ticks() >> 16;}
+
+		// edge generator
+		static void send(const uint8_t data0, const uint8_t data1, const uint64_t value,
+			const uint8_t bits, const WiegandTiming & timing = WiegandTiming());
+		static void pulse(const uint8_t pin, const uint64_t at, const uint16_t width);
+		static uint64_t end();
+
+		// plays schedule up to time until, or whole schedule and WIEGAND_MAX_BIT_INTERVAL after it
+		static void run(const uint64_t until, void (*poll)(), const uint32_t poll_period);
+		static void run(void (*poll)(), const uint32_t poll_period);
+};
+
+#endif
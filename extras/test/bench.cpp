@@ -0,0 +1,122 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * THROUGHPUT BENCHMARK
+ *
+ * Sends random H10301 cards through WiegandSim with a range of gaps between messages and
+ * reports, for each gap, how many cards per second of simulated time were decoded correctly,
+ * and how fast the host ran the decoder (edges per second of real time). Loop polls every
+ * millisecond, as a sketch doing other work would. Gaps shorter than the bit timeout merge
+ * messages, so decoded rate shows where the timeout limits throughput with Wiegand.h settings of
+ * the build (see WIEGAND_ADAPTIVE_TIMEOUT).
+ *
+ * Build and run from this directory:
+ *     make bench && ./bench [cards per gap]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Arduino.h"
+#include "Wiegand.h"
+#include "WiegandSim.h"
+
+#if !defined(WIEGAND_HAL_HOST)
+	#error benchmark must be built with WIEGAND_HAL_HOST
+#endif
+
+static Wiegand * rx;
+static const uint32_t * expected;
+static unsigned long expected_count;
+static unsigned long decoded;
+static unsigned long taken;
+
+static uint32_t h10301(const uint8_t facility, const uint16_t card)
+{
+	uint32_t data = ((uint32_t)facility << 16) | card;
+	uint8_t even = 0;
+	uint8_t odd = 1;
+	for (uint8_t i = 0; i < 12; i++)
+	{
+		odd ^= (data >> i) & 1;
+		even ^= (data >> (i + 12)) & 1;
+	}
+	return ((uint32_t)even << 25) | (data << 1) | odd;
+}
+
+// counts messages equal to the next expected card
+static void poll()
+{
+	while (rx->finishRead())
+	{
+		if (taken < expected_count && rx->bit_count == 26 && rx->frame().toUint32() == expected[taken])
+			decoded++;
+		taken++;
+		rx->clear();
+	}
+	if (rx->status == Wiegand::Error)
+		rx->clear();
+}
+
+static double seconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char ** argv)
+{
+	unsigned long cards = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	static const uint32_t gaps[] = {1000, 2000, 4000, 6000, 10000, 20000, 50000};
+	uint32_t * values = new uint32_t[cards];
+
+	rx = new Wiegand(0, 1);
+	if (!rx->begin())
+	{
+		printf("begin failed\n");
+		return 1;
+	}
+
+	printf("%lu cards per gap, 26 bits, 2000us bit interval, 50us pulses, 100us jitter\n", cards);
+	printf("%8s %12s %10s %14s\n", "gap us", "cards/s sim", "decoded %", "edges/s host");
+	for (size_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++)
+	{
+		WiegandSim::reset(0xFFFFFFFFULL - 1000000, g + 1);
+		while (rx->finishRead())
+			rx->clear();
+		rx->clear();
+
+		WiegandTiming timing(50, 2000, 100, gaps[g]);
+		for (unsigned long i = 0; i < cards; i++)
+		{
+			values[i] = h10301(WiegandSim::random(), WiegandSim::random());
+			WiegandSim::send(0, 1, values[i], 26, timing);
+		}
+
+		expected = values;
+		expected_count = cards;
+		decoded = 0;
+		taken = 0;
+		uint64_t start = WiegandSim::now();
+		double started = seconds();
+		WiegandSim::run(poll, 1000);
+		double elapsed = seconds() - started;
+		double simulated = (WiegandSim::now() - start) / 1e6;
+
+		printf("%8lu %12.1f %10.2f %14.0f\n", (unsigned long)gaps[g], decoded / simulated,
+			100.0 * decoded / cards, cards * 26 / elapsed);
+	}
+
+	delete[] values;
+	return 0;
+}
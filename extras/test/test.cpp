@@ -0,0 +1,1316 @@
+/*
+ * Wiegand protocol library for Arduino.
+ * Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ *
+ *
+ *
+ * TESTS
+ *
+ * Runs the receiver against messages of WiegandSim edge generator, with Wiegand.h settings of
+ * the build. Options which are commented out in Wiegand.h can be given to compiler, tests of
+ * options which aren't defined are skipped. Every receiver test uses its own receiver on its own
+ * pins, since registry slots can't be released, tests of other classes get no receiver. Prints
+ * failed checks and number of failed tests, exit status is 1 if any test failed.
+ *
+ * Build and run from this directory:
+ *     make check
+ *     make check DEFS="-DWIEGAND_ADAPTIVE_TIMEOUT=3 -DWIEGAND_MIN_BIT_INTERVAL=100"
+ *
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "Arduino.h"
+#include "Wiegand.h"
+#include "WiegandAccess.h"
+#include "WiegandHub.h"
+#include "WiegandKeypad.h"
+#include "WiegandLink.h"
+#include "WiegandOut.h"
+#include "WiegandSim.h"
+
+#if !defined(WIEGAND_HAL_HOST)
+	#error tests must be built with WIEGAND_HAL_HOST
+#endif
+
+static const char * current_test;
+static bool current_failed;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, current_test, #condition); \
+			current_failed = true; \
+		} \
+	} \
+	while (0)
+
+// message as taken by poll
+struct Received
+{
+	uint8_t bits;
+	uint64_t value;
+	uint32_t total_micros;
+};
+
+static Wiegand * rx;
+static uint8_t data0;
+static uint8_t data1;
+static std::vector<Received> received;
+static unsigned long errors;
+
+// next free pair of pins, each test gets a new receiver
+static uint8_t next_pin;
+
+static Wiegand * newReceiver(uint8_t & low_pin, uint8_t & high_pin)
+{
+	low_pin = next_pin;
+	high_pin = next_pin + 1;
+	next_pin += 2;
+	Wiegand * receiver = new Wiegand(low_pin, high_pin);
+	return receiver->begin() ? receiver : NULL;
+}
+
+// stands in for loop, takes every completed message and error of rx
+static void poll()
+{
+	while (rx->finishRead())
+	{
+		Received message;
+		message.bits = rx->bit_count;
+		message.value = rx->frame().toUint64();
+#if defined(WIEGAND_MESSAGE_TIMING)
+		message.total_micros = rx->total_micros;
+#else
+		message.total_micros = 0;
+#endif
+		received.push_back(message);
+		rx->clear();
+	}
+
+	if (rx->status == Wiegand::Error)
+	{
+		errors++;
+		rx->clear();
+	}
+}
+
+static void noPoll()
+{
+}
+
+// H10301 message with parity
+static uint32_t h10301(const uint8_t facility, const uint16_t card)
+{
+	uint32_t data = ((uint32_t)facility << 16) | card;
+	uint8_t even = 0;
+	uint8_t odd = 1;
+	for (uint8_t i = 0; i < 12; i++)
+	{
+		odd ^= (data >> i) & 1;
+		even ^= (data >> (i + 12)) & 1;
+	}
+	return ((uint32_t)even << 25) | (data << 1) | odd;
+}
+
+static bool isCard(const Received & message, const uint8_t facility, const uint16_t card)
+{
+	return message.bits == 26 && message.value == h10301(facility, card);
+}
+
+// gap after which next message surely starts a new one
+static const uint32_t NEXT = WIEGAND_MAX_BIT_INTERVAL + 1000;
+
+// shortest pulse receiver takes for a bit
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+static const uint16_t SHORT_PULSE = WIEGAND_MIN_PULSE_WIDTH + 5;
+#else
+static const uint16_t SHORT_PULSE = 5;
+#endif
+
+static void testDecode()
+{
+	WiegandSim::send(data0, data1, h10301(1, 2), 26);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 1);
+	CHECK(errors == 0);
+	CHECK(received.size() == 1 && isCard(received[0], 1, 2));
+#if defined(WIEGAND_MESSAGE_TIMING)
+	CHECK(received.size() == 1 && received[0].total_micros == 25 * 2000);
+#endif
+
+	WiegandSim::send(data0, data1, h10301(200, 40000), 26);
+	WiegandSim::run(noPoll, 0);
+	CHECK(rx->finishRead());
+	WiegandCard card;
+	CHECK(rx->decode(card));
+	CHECK(card.format == WiegandFormat::H10301 && card.facility == 200 && card.card == 40000);
+	rx->clear();
+}
+
+static void testLengths()
+{
+	// every length up to WIEGAND_MAX_BITS which is not a known format, so parity doesn't matter
+	std::vector<uint8_t> lengths;
+	for (uint8_t bits = 1; bits <= WIEGAND_MAX_BITS; bits++)
+	{
+		if (WiegandFormat::find(bits) != WiegandFormat::Unknown)
+			continue;
+		lengths.push_back(bits);
+		WiegandSim::send(data0, data1, 0x15A5A5A5A5ULL & (((uint64_t)1 << bits) - 1), bits);
+	}
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == lengths.size());
+	for (size_t i = 0; i < received.size() && i < lengths.size(); i++)
+	{
+		CHECK(received[i].bits == lengths[i]);
+		CHECK(received[i].value == (0x15A5A5A5A5ULL & (((uint64_t)1 << lengths[i]) - 1)));
+	}
+	CHECK(errors == 0);
+}
+
+static void testParity()
+{
+#if defined(WIEGAND_CHECK_PARITY)
+	// H10301 with wrong parity is dropped, statistics count it
+	WiegandSim::send(data0, data1, h10301(1, 2) ^ 1, 26);
+	WiegandSim::send(data0, data1, h10301(1, 3), 26);
+	WiegandSim::run(poll, 1000);
+	CHECK(received.size() == 1 && isCard(received[0], 1, 3));
+#if defined(WIEGAND_STATS)
+	WiegandStats stats;
+	rx->getStats(stats);
+	CHECK(stats.parity_errors == 1);
+#endif
+#endif
+}
+
+// known good frame of each format, built from published layouts, first bit in the highest bit
+struct FormatFrame
+{
+	uint8_t bits;
+	uint64_t value;
+	WiegandFormat::WiegandFormatType format;
+	uint32_t facility;
+	uint32_t card;
+	uint64_t parity_bit;		// a parity bit, or 0 for formats without parity
+};
+
+static const FormatFrame format_frames[] =
+{
+	// H10306: even parity of bits 1-16, facility 1-16, card 17-32, odd parity of bits 17-32
+	{34, 0x224697DDEULL, WiegandFormat::H10306, 0x1234, 0xBEEF, 1ULL << 33},
+	// Corporate 1000: odd parity of all bits, even parity of two of every three bits from 2,
+	// facility 2-13, card 14-33, odd parity of two of every three bits from 1
+	{35, 0x55793579BULL, WiegandFormat::Corporate1000, 0xABC, 0x9ABCD, 1ULL},
+	// C15001: even parity of bits 1-17, OEM code 1-8, facility 9-18, card 19-34, odd parity 18-34
+	{36, 0x2D5869A5CULL, WiegandFormat::C15001, 0x2C3, 0x4D2E, 1ULL},
+	// H10304: even parity of bits 1-18, facility 1-16, card 17-35, odd parity of bits 18-35
+	{37, 0x1CAFEFFFFCULL, WiegandFormat::H10304, 0xCAFE, 0x7FFFE, 1ULL << 36},
+	// key 7 as 4 bits, no parity
+	{4, 0x7, WiegandFormat::Keypad4, 0, 7, 0},
+	// key 3 as 8 bits, complement of key in upper nibble
+	{8, 0xC3, WiegandFormat::Keypad8, 0, 3, 1ULL << 7},
+};
+
+static void testFormats()
+{
+	for (uint8_t i = 0; i < sizeof(format_frames) / sizeof(format_frames[0]); i++)
+	{
+		const FormatFrame & frame = format_frames[i];
+		CHECK(WiegandFormat::find(frame.bits) == frame.format);
+
+		WiegandSim::send(data0, data1, frame.value, frame.bits);
+		WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+		WiegandCard card;
+		CHECK(rx->finishRead() && rx->bit_count == frame.bits && rx->decode(card));
+		CHECK(card.format == frame.format && card.facility == frame.facility && card.card == frame.card
+			&& card.parity_ok);
+		rx->clear();
+
+		// the same frame with a flipped parity bit is dropped, or decoded with bad parity
+		if (frame.parity_bit == 0)
+			continue;
+		WiegandSim::send(data0, data1, frame.value ^ frame.parity_bit, frame.bits);
+		WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+#if defined(WIEGAND_CHECK_PARITY)
+		CHECK(!rx->finishRead());
+#else
+		CHECK(rx->finishRead() && rx->decode(card) && card.format == frame.format && !card.parity_ok);
+		rx->clear();
+#endif
+	}
+}
+
+static void testPulseWidthAndJitter()
+{
+	// receiver reacts to falling edges only, so pulse width doesn't matter above the minimum
+	WiegandSim::send(data0, data1, h10301(1, 1), 26, WiegandTiming(SHORT_PULSE));
+	WiegandSim::send(data0, data1, h10301(1, 2), 26, WiegandTiming(500));
+
+	// 100 random cards with intervals 1000 +-500 us
+	uint16_t cards[100];
+	for (uint8_t i = 0; i < 100; i++)
+	{
+		cards[i] = WiegandSim::random();
+		WiegandSim::send(data0, data1, h10301(i, cards[i]), 26, WiegandTiming(50, 1000, 500));
+	}
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 102);
+	CHECK(received.size() >= 2 && isCard(received[0], 1, 1) && isCard(received[1], 1, 2));
+	for (uint8_t i = 0; i < 100 && i + 2U < received.size(); i++)
+		CHECK(isCard(received[i + 2], i, cards[i]));
+	CHECK(errors == 0);
+}
+
+static void testBackToBack()
+{
+	// messages just over the timeout apart, loop doesn't poll until all of them arrived, so
+	// each next message queues the previous one
+	for (uint8_t i = 0; i < WIEGAND_QUEUE_SIZE; i++)
+		WiegandSim::send(data0, data1, h10301(1, i), 26, WiegandTiming(50, 2000, 0, NEXT));
+	WiegandSim::run(WiegandSim::end(), noPoll, 0);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == WIEGAND_QUEUE_SIZE);
+	for (uint8_t i = 0; i < received.size(); i++)
+		CHECK(isCard(received[i], 1, i));
+}
+
+static void testQueueOverflow()
+{
+	// queue holds WIEGAND_QUEUE_SIZE messages, the last one is taken as it times out, the rest
+	// are lost and counted
+	for (uint8_t i = 0; i < WIEGAND_QUEUE_SIZE + 3; i++)
+		WiegandSim::send(data0, data1, h10301(1, i), 26, WiegandTiming(50, 2000, 0, NEXT));
+	WiegandSim::run(WiegandSim::end(), noPoll, 0);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == WIEGAND_QUEUE_SIZE + 1);
+	for (uint8_t i = 0; i < WIEGAND_QUEUE_SIZE && i < received.size(); i++)
+		CHECK(isCard(received[i], 1, i));
+	CHECK(received.size() == WIEGAND_QUEUE_SIZE + 1 && isCard(received.back(), 1, WIEGAND_QUEUE_SIZE + 2));
+#if defined(WIEGAND_STATS)
+	WiegandStats stats;
+	rx->getStats(stats);
+	CHECK(stats.overruns == 2);
+#endif
+}
+
+static void testMicrosWrap()
+{
+	// micros() wraps at 32 bits in the middle of a message, and between a message and the next
+	// one which queues it
+	WiegandSim::setTime(0xFFFFFFFFULL - 30000);
+	WiegandSim::send(data0, data1, h10301(7, 7), 26, WiegandTiming(50, 2000, 0, 0));
+	WiegandSim::run(poll, 1000);
+
+	WiegandSim::setTime(0x1FFFFFFFFULL - 52000);
+	WiegandSim::send(data0, data1, h10301(7, 8), 26, WiegandTiming(50, 2000, 0, 0));
+	WiegandSim::send(data0, data1, h10301(7, 9), 26, WiegandTiming(50, 2000, 0, NEXT));
+	WiegandSim::run(WiegandSim::end(), noPoll, 0);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 3);
+	CHECK(received.size() == 3 && isCard(received[0], 7, 7) && isCard(received[1], 7, 8)
+		&& isCard(received[2], 7, 9));
+#if defined(WIEGAND_MESSAGE_TIMING)
+	for (uint8_t i = 0; i < received.size(); i++)
+		CHECK(received[i].total_micros == 25 * 2000);
+#endif
+}
+
+static void testTooLong()
+{
+	// message longer than WIEGAND_MAX_BITS is reported once, then receiver recovers by itself
+	WiegandSim::send(data0, data1, 0, WIEGAND_MAX_BITS + 5);
+	WiegandSim::send(data0, data1, h10301(3, 3), 26, WiegandTiming(50, 2000, 0, NEXT));
+	WiegandSim::run(poll, 1000);
+
+	CHECK(errors == 1);
+	CHECK(received.size() == 1 && isCard(received[0], 3, 3));
+}
+
+static void testEdgeDuringPoll()
+{
+	// message timed out but wasn't taken, next one starts right after poll read micros()
+	WiegandSim::send(data0, data1, h10301(4, 1), 26);
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+	WiegandSim::onMicros(data1);
+	poll();
+	CHECK(received.size() == 1 && isCard(received[0], 4, 1));
+
+	// the bit fired from micros() belongs to the next message
+	WiegandSim::send(data0, data1, h10301(4, 2) & 0x1FFFFFF, 25, WiegandTiming(50, 2000, 0, 2000));
+	WiegandSim::run(poll, 1000);
+	CHECK(received.size() == 2 && isCard(received[1], 4, 2));
+}
+
+static void testInterruptsDisabled()
+{
+	// two edges of one line while interrupts are disabled leave one flag, as on AVR
+	uint64_t start = WiegandSim::now();
+	noInterrupts();
+	WiegandSim::pulse(data0, start + 10, 20);
+	WiegandSim::pulse(data0, start + 40, 20);
+	WiegandSim::pulse(data1, start + 100, 500);
+	WiegandSim::run(start + 200, noPoll, 0);
+	interrupts();
+	WiegandSim::run(WiegandSim::now() + NEXT, poll, 1000);
+
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	// DATA0 is high again when its ISR runs, so its edge is taken for a spike
+	CHECK(received.size() == 1 && received[0].bits == 1 && received[0].value == 1);
+#elif defined(WIEGAND_MIN_BIT_INTERVAL)
+	// both ISRs run at the same time when interrupts are enabled, so the second is taken for a bounce
+	CHECK(received.size() == 1 && received[0].bits == 1 && received[0].value == 0);
+#else
+	CHECK(received.size() == 1 && received[0].bits == 2 && received[0].value == 1);
+#endif
+}
+
+static void testSuspend()
+{
+	rx->suspend();
+	WiegandSim::send(data0, data1, h10301(1, 1), 26);
+	WiegandSim::run(poll, 1000);
+	rx->resume();
+	WiegandSim::send(data0, data1, h10301(1, 2), 26);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 1 && isCard(received[0], 1, 2));
+}
+
+static void testReadApi()
+{
+	for (uint8_t i = 0; i < 3; i++)
+		WiegandSim::send(data0, data1, h10301(2, i), 26, WiegandTiming(50, 2000, 0, NEXT));
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+
+	CHECK(rx->available() == 3);
+	// messages are ready, and host can't sleep anyway
+	CHECK(!Wiegand::sleep());
+	WiegandMessage message;
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		CHECK(rx->read(message));
+		CHECK(WiegandFrame(message).toUint64() == h10301(2, i));
+	}
+	CHECK(!rx->read(message));
+	CHECK(rx->available() == 0);
+}
+
+static unsigned long callback_messages;
+static unsigned long callback_errors;
+
+static void onMessage(WiegandReceiver &, const WiegandMessage & message)
+{
+	if (WiegandFrame(message).toUint64() == h10301(5, callback_messages))
+		callback_messages++;
+}
+
+static void onError(WiegandReceiver &)
+{
+	callback_errors++;
+}
+
+static void dispatch()
+{
+	Wiegand::tick();
+	Wiegand::dispatch();
+}
+
+static void testDispatch()
+{
+	rx->onMessage(onMessage);
+	rx->onError(onError);
+	WiegandSim::send(data0, data1, h10301(5, 0), 26);
+	WiegandSim::send(data0, data1, 0, WIEGAND_MAX_BITS + 1);
+	WiegandSim::send(data0, data1, h10301(5, 1), 26);
+	WiegandSim::run(dispatch, 1000);
+
+	CHECK(callback_messages == 2);
+	CHECK(callback_errors == 1);
+}
+
+static void testHub()
+{
+	// second bus, messages of both buses overlap and come out in order of their last bit
+	uint8_t other_data0;
+	uint8_t other_data1;
+	Wiegand * other = newReceiver(other_data0, other_data1);
+	CHECK(other != NULL);
+	if (other == NULL)
+		return;
+
+	WiegandHub hub;
+	CHECK(hub.add(*rx) == 0);
+	CHECK(hub.add(*other) == 1);
+
+	WiegandSim::send(data0, data1, h10301(1, 1), 26);
+	WiegandSim::send(other_data0, other_data1, h10301(2, 2), 26, WiegandTiming(50, 1900, 0, 0));
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+
+	CHECK(hub.poll() == 2);
+	WiegandEvent first;
+	WiegandEvent second;
+	CHECK(hub.read(first) && hub.read(second));
+	CHECK(first.bus == 0 && WiegandFrame(first.message).toUint64() == h10301(1, 1));
+	CHECK(second.bus == 1 && WiegandFrame(second.message).toUint64() == h10301(2, 2));
+	CHECK(second.sequence == first.sequence + 1);
+
+	// when event queue is full, messages wait in queues of their buses and nothing is lost
+	for (uint8_t i = 0; i < WIEGAND_HUB_QUEUE_SIZE + 2; i++)
+	{
+		WiegandSim::send(data0, data1, h10301(3, i), 26);
+		WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+		hub.poll();
+	}
+	CHECK(hub.available() == WIEGAND_HUB_QUEUE_SIZE);
+	CHECK(rx->available() == 2);
+	WiegandEvent event;
+	for (uint8_t i = 0; i < WIEGAND_HUB_QUEUE_SIZE; i++)
+		CHECK(hub.read(event) && WiegandFrame(event.message).toUint64() == h10301(3, i));
+	CHECK(hub.poll() == 2);
+	for (uint8_t i = WIEGAND_HUB_QUEUE_SIZE; i < WIEGAND_HUB_QUEUE_SIZE + 2; i++)
+		CHECK(hub.read(event) && WiegandFrame(event.message).toUint64() == h10301(3, i));
+#if defined(WIEGAND_STATS)
+	CHECK(hub.overruns() == 0);
+#endif
+}
+
+// key message, Keypad8 carries complement of the key in upper nibble
+static void sendKey(const uint8_t key, const bool keypad8)
+{
+	if (keypad8)
+		WiegandSim::send(data0, data1, (~key & 0x0F) << 4 | key, 8);
+	else
+		WiegandSim::send(data0, data1, key, 4);
+}
+
+// feeds every message of rx to keypad, returns number of completed credentials
+static uint8_t feedKeypad(WiegandKeypad & keypad)
+{
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+	uint8_t completed = 0;
+	WiegandMessage message;
+	while (rx->read(message))
+	{
+		if (keypad.feed(message))
+			completed++;
+	}
+	return completed;
+}
+
+static void testKeypad()
+{
+	WiegandKeypad keypad;
+	for (uint8_t keypad8 = 0; keypad8 < 2; keypad8++)
+	{
+		// digits and Enter make a PIN without card
+		sendKey(1, keypad8);
+		sendKey(2, keypad8);
+		sendKey(3, keypad8);
+		sendKey(WiegandKeypad::Enter, keypad8);
+		CHECK(feedKeypad(keypad) == 1);
+		CHECK(!keypad.credential.has_card && strcmp(keypad.credential.pin, "123") == 0);
+
+		// Clear drops digits, Enter after it has nothing to complete
+		sendKey(7, keypad8);
+		sendKey(WiegandKeypad::Clear, keypad8);
+		sendKey(WiegandKeypad::Enter, keypad8);
+		CHECK(feedKeypad(keypad) == 0);
+		sendKey(4, keypad8);
+		sendKey(WiegandKeypad::Enter, keypad8);
+		CHECK(feedKeypad(keypad) == 1);
+		CHECK(strcmp(keypad.credential.pin, "4") == 0);
+
+		// card and PIN entered after it make one credential
+		WiegandSim::send(data0, data1, h10301(5, 77 + keypad8), 26);
+		sendKey(9, keypad8);
+		sendKey(8, keypad8);
+		sendKey(WiegandKeypad::Enter, keypad8);
+		CHECK(feedKeypad(keypad) == 1);
+		CHECK(keypad.credential.has_card && keypad.credential.card.facility == 5
+			&& keypad.credential.card.card == 77U + keypad8 && strcmp(keypad.credential.pin, "98") == 0);
+
+		// card stays after Clear
+		WiegandSim::send(data0, data1, h10301(5, 80 + keypad8), 26);
+		sendKey(6, keypad8);
+		sendKey(WiegandKeypad::Clear, keypad8);
+		sendKey(WiegandKeypad::Enter, keypad8);
+		CHECK(feedKeypad(keypad) == 1);
+		CHECK(keypad.credential.has_card && keypad.credential.pin_length == 0);
+	}
+
+	// Keypad8 message with wrong complement is ignored
+	WiegandSim::send(data0, data1, 0x15, 8);
+	sendKey(WiegandKeypad::Enter, true);
+	CHECK(feedKeypad(keypad) == 0);
+
+	// unfinished PIN is dropped after WIEGAND_PIN_TIMEOUT without messages
+	sendKey(5, false);
+	CHECK(feedKeypad(keypad) == 0);
+	WiegandSim::run(WiegandSim::now() + WIEGAND_PIN_TIMEOUT * 1000UL / 2, noPoll, 0);
+	CHECK(!keypad.timedOut());
+	WiegandSim::run(WiegandSim::now() + WIEGAND_PIN_TIMEOUT * 1000UL, noPoll, 0);
+	CHECK(keypad.timedOut());
+	sendKey(WiegandKeypad::Enter, false);
+	CHECK(feedKeypad(keypad) == 0);
+}
+
+// id of H10301 card with facility code 1
+static uint64_t accessId(const uint32_t card)
+{
+	return WIEGAND_ACCESS_ID(WiegandFormat::H10301, 1, card);
+}
+
+// sorted table in PROGMEM, cards 10, 20 ... 1000
+static uint64_t access_table[100] PROGMEM;
+
+static void testAccessSearch()
+{
+	EEPROM.reset();
+	for (uint16_t i = 0; i < 100; i++)
+		access_table[i] = accessId((i + 1) * 10);
+	WiegandAccessList list(access_table, 100, 0);
+	list.begin();
+
+	// every id is found, ids next to them and past both ends are not
+	bool ok = true;
+	for (uint32_t card = 0; card <= 1010; card++)
+		ok = ok && list.allowed(accessId(card)) == (card % 10 == 0 && card >= 10 && card <= 1000);
+	CHECK(ok);
+
+	// same numbers in other format or facility are other cards
+	CHECK(!list.allowed(WIEGAND_ACCESS_ID(WiegandFormat::H10306, 1, 10)));
+	CHECK(!list.allowed(WIEGAND_ACCESS_ID(WiegandFormat::H10301, 2, 10)));
+	WiegandCard card = {WiegandFormat::H10301, 1, 10, true};
+	CHECK(list.allowed(card));
+	card.parity_ok = false;
+	CHECK(!list.allowed(card));
+	WiegandCard key = {WiegandFormat::Keypad8, 1, 10, true};
+	CHECK(!list.allowed(key));
+}
+
+static void testAccessJournal()
+{
+	EEPROM.reset();
+	for (uint16_t i = 0; i < 100; i++)
+		access_table[i] = accessId((i + 1) * 10);
+	WiegandAccessList list(access_table, 100, 0);
+	list.begin();
+
+	// newest journal entry wins over table and older entries
+	CHECK(list.remove(accessId(20)) && !list.allowed(accessId(20)));
+	CHECK(list.add(accessId(25)) && list.allowed(accessId(25)));
+	CHECK(list.add(accessId(20)) && list.allowed(accessId(20)));
+	CHECK(list.remove(accessId(25)) && !list.allowed(accessId(25)));
+	CHECK(list.allowed(accessId(10)) && list.allowed(accessId(30)));
+
+	// journal survives restart
+	WiegandAccessList restarted(access_table, 100, 0);
+	restarted.begin();
+	CHECK(restarted.allowed(accessId(20)) && !restarted.allowed(accessId(25)));
+
+	// remove of unknown and add of allowed id don't use journal, PROGMEM table can't be compacted
+	CHECK(list.remove(accessId(5)) && list.add(accessId(30)));
+	CHECK(EEPROM.read(0) == 4);
+	for (uint32_t card = 1; card <= 12; card++)
+		CHECK(list.add(accessId(card * 10 + 1)));
+	CHECK(!list.add(accessId(500 + 1)) && !list.remove(accessId(40)));
+	CHECK(list.allowed(accessId(121)) && !list.allowed(accessId(501)) && list.allowed(accessId(40)));
+
+	// clear resets to the table
+	list.clear();
+	CHECK(!list.allowed(accessId(11)) && list.allowed(accessId(20)) && !list.allowed(accessId(25)));
+}
+
+// compares list with allowed flags of cards 0 to count - 1
+static bool accessMatches(WiegandAccessList & list, const std::vector<bool> & expected)
+{
+	for (uint32_t card = 0; card < expected.size(); card++)
+	{
+		if (list.allowed(accessId(card)) != expected[card])
+			return false;
+	}
+	return true;
+}
+
+static void testAccessCompaction()
+{
+	// table of 60 ids at 0, journal after it
+	const int journal = 2 + 60 * 8;
+	EEPROM.reset();
+	WiegandAccessList list(0, 60, journal);
+	list.begin();
+
+	// mixed adds and removes of random cards, many of them repeated within one journal
+	std::vector<bool> expected(100, false);
+	uint32_t random = 12345;
+	unsigned int count = 0;
+	bool ok = true;
+	for (uint16_t i = 0; i < 400; i++)
+	{
+		random = random * 1103515245UL + 12345;
+		uint32_t card = (random >> 16) % 100;
+		bool add = (random >> 8) % 3 != 0 && count < 50;
+		ok = ok && (add ? list.add(accessId(card)) : list.remove(accessId(card)));
+		if (add != expected[card])
+			count += add ? 1 : -1;
+		expected[card] = add;
+		if (i % 20 == 19)
+			ok = ok && accessMatches(list, expected);
+	}
+	CHECK(ok);
+
+	// table stays sorted, restarted list reads the same
+	uint16_t table_count;
+	EEPROM.get(0, table_count);
+	uint64_t previous = 0;
+	uint64_t id;
+	for (uint16_t i = 0; i < table_count; i++)
+	{
+		EEPROM.get(2 + i * 8, id);
+		CHECK(i == 0 || id > previous);
+		previous = id;
+	}
+	WiegandAccessList restarted(0, 60, journal);
+	restarted.begin();
+	CHECK(accessMatches(restarted, expected));
+
+	// journal of ids in front of 48 ids moves each of them once, so table is written only once
+	EEPROM.reset();
+	WiegandAccessList big(0, 80, 2 + 80 * 8);
+	big.begin();
+	for (uint32_t card = 0; card < 48; card++)
+		CHECK(big.add(accessId(100 + card)));
+	for (uint32_t card = 0; card < WIEGAND_ACCESS_JOURNAL; card++)
+		CHECK(big.add(accessId(card)));
+	EEPROM.get(0, table_count);
+	CHECK(table_count == 48);
+	unsigned long writes = EEPROM.writes;
+	CHECK(big.add(accessId(50)));
+	CHECK(EEPROM.writes - writes <= (48UL + WIEGAND_ACCESS_JOURNAL) * 8 + 2 + 1 + 9 + 1);
+	EEPROM.get(0, table_count);
+	CHECK(table_count == 48 + WIEGAND_ACCESS_JOURNAL);
+
+	// removes and adds in between table ids
+	std::vector<bool> all(200, false);
+	for (uint32_t card = 0; card < 200; card++)
+		all[card] = big.allowed(accessId(card));
+	for (uint32_t card = 0; card < 2 * WIEGAND_ACCESS_JOURNAL; card++)
+	{
+		uint32_t changed = card * 7 % 160;
+		CHECK(all[changed] ? big.remove(accessId(changed)) : big.add(accessId(changed)));
+		all[changed] = !all[changed];
+	}
+	CHECK(accessMatches(big, all));
+	WiegandAccessList big_restarted(0, 80, 2 + 80 * 8);
+	big_restarted.begin();
+	CHECK(accessMatches(big_restarted, all));
+}
+
+static void testAccessFull()
+{
+	const int journal = 2 + 8 * 8;
+	EEPROM.reset();
+	WiegandAccessList list(0, 8, journal);
+	list.begin();
+
+	// journal takes more changes than table has room for, compaction then fails and changes nothing
+	for (uint32_t card = 0; card < WIEGAND_ACCESS_JOURNAL; card++)
+		CHECK(list.add(accessId(card)));
+	uint8_t before[sizeof(EEPROM.memory)];
+	memcpy(before, EEPROM.memory, sizeof(before));
+	CHECK(!list.add(accessId(100)) && !list.remove(accessId(0)));
+	CHECK(memcmp(before, EEPROM.memory, sizeof(before)) == 0);
+	CHECK(list.allowed(accessId(0)) && list.allowed(accessId(WIEGAND_ACCESS_JOURNAL - 1)));
+	CHECK(!list.allowed(accessId(100)));
+
+	// removes within the journal make room again
+	list.clear();
+	const uint32_t removed = (WIEGAND_ACCESS_JOURNAL - 8) / 2;
+	for (uint32_t card = 0; card < 8; card++)
+		CHECK(list.add(accessId(card)));
+	for (uint32_t card = 0; card < removed; card++)
+		CHECK(list.remove(accessId(card)));
+	for (uint32_t card = 8; card < 8 + removed; card++)
+		CHECK(list.add(accessId(card)));
+	CHECK(list.add(accessId(100)));
+	uint16_t table_count;
+	EEPROM.get(0, table_count);
+	CHECK(table_count == 8);
+	CHECK(list.allowed(accessId(100)) && list.allowed(accessId(7)) && !list.allowed(accessId(0)));
+}
+
+static void testAccessBloom()
+{
+#if WIEGAND_ACCESS_BLOOM_BYTES > 0
+	EEPROM.reset();
+	WiegandAccessList list(0, 60, 2 + 60 * 8);
+	list.begin();
+	for (uint32_t card = 0; card < 2 * WIEGAND_ACCESS_JOURNAL; card++)
+		CHECK(list.add(accessId(card * 1000)));
+	list.begin();
+
+	// unknown cards are rejected, almost all of them without reading EEPROM
+	unsigned int read = 0;
+	for (uint32_t card = 1; card < 1000; card++)
+	{
+		unsigned long reads = EEPROM.reads;
+		CHECK(!list.allowed(accessId(card)));
+		if (EEPROM.reads != reads)
+			read++;
+	}
+	CHECK(read < 50);
+
+	// removed ids stay in filter, so they are read and rejected
+	CHECK(list.remove(accessId(0)) && !list.allowed(accessId(0)));
+	CHECK(list.allowed(accessId(1000)));
+#endif
+}
+
+// output of link, takes at most room bytes, which are then used up
+// writing more than availableForWrite returned would block on a real serial port
+class LinkOutput : public Print
+{
+	public:
+		std::vector<uint8_t> bytes;
+		int room;
+		unsigned int writes;
+		bool blocked;
+
+		LinkOutput() :room(0), writes(0), blocked(false) {}
+		size_t write(uint8_t value) {return write(&value, 1);}
+		size_t write(const uint8_t * buffer, size_t size)
+		{
+			if (size > (size_t)room)
+			{
+				blocked = true;
+				size = room;
+			}
+			bytes.insert(bytes.end(), buffer, buffer + size);
+			room -= size;
+			writes++;
+			return size;
+		}
+		int availableForWrite() {return room;}
+};
+
+// CRC-16/CCITT-FALSE, as WiegandLink.h describes it
+static uint16_t linkCrc(const std::vector<uint8_t> & data, const size_t length)
+{
+	uint16_t crc = 0xFFFF;
+	for (size_t i = 0; i < length; i++)
+	{
+		crc ^= (uint16_t)data[i] << 8;
+		for (uint8_t bit = 0; bit < 8; bit++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+// splits bytes of output at zero delimiters, COBS decodes each frame and checks its CRC
+// returns records without CRC, an empty record stands for a malformed frame
+static std::vector<std::vector<uint8_t> > linkRecords(const std::vector<uint8_t> & bytes)
+{
+	std::vector<std::vector<uint8_t> > records;
+	size_t start = 0;
+	for (size_t end = 0; end < bytes.size(); end++)
+	{
+		if (bytes[end] != 0)
+			continue;
+
+		std::vector<uint8_t> record;
+		bool ok = end > start;
+		for (size_t code = start; ok && code < end; )
+		{
+			uint8_t distance = bytes[code];
+			ok = code + distance <= end;
+			for (size_t i = code + 1; ok && i < code + distance; i++)
+				record.push_back(bytes[i]);
+			code += distance;
+			if (ok && code < end)
+				record.push_back(0);
+		}
+		ok = ok && record.size() >= 2
+			&& linkCrc(record, record.size() - 2) == (record[record.size() - 2] | record[record.size() - 1] << 8);
+		if (ok)
+			record.resize(record.size() - 2);
+		else
+			record.clear();
+		records.push_back(record);
+		start = end + 1;
+	}
+	return records;
+}
+
+// expected record of 26 bit H10301 message
+static std::vector<uint8_t> linkRecord(const uint8_t bus, const uint64_t value, const uint32_t duration)
+{
+	std::vector<uint8_t> record;
+	record.push_back(bus);
+	record.push_back(Wiegand::Done);
+	record.push_back(26);
+	for (uint8_t i = 0; i < 4; i++)
+		record.push_back(value >> (i * 8));
+	for (uint8_t i = 0; i < 4; i++)
+		record.push_back(duration >> (i * 8));
+	return record;
+}
+
+static void testLink()
+{
+	std::vector<uint8_t> check(9);
+	memcpy(&check[0], "123456789", 9);
+	CHECK(linkCrc(check, 9) == 0x29B1);
+
+	LinkOutput output;
+	output.room = 1000;
+	WiegandLink link(output);
+
+	// message record, 26 bits take 15 bytes with COBS code and delimiter
+	WiegandMessage message;
+	memset(&message, 0, sizeof(message));
+	message.bit_count = 26;
+	for (uint8_t i = 0; i < 4; i++)
+		message.rcv_buffer[i] = h10301(1, 2) >> (i * 8);
+#if defined(WIEGAND_MESSAGE_TIMING)
+	message.total_micros = 51234;
+	const uint32_t duration = 51234;
+#else
+	const uint32_t duration = 0;
+#endif
+	CHECK(link.send(3, message));
+	CHECK(output.bytes.size() == 15 && output.writes == 1);
+	std::vector<std::vector<uint8_t> > records = linkRecords(output.bytes);
+	CHECK(records.size() == 1 && records[0] == linkRecord(3, h10301(1, 2), duration));
+
+	// error record is zeros but status, which are replaced by COBS codes
+	output.bytes.clear();
+	CHECK(link.send(0, Wiegand::Error, 0, NULL, 0));
+	std::vector<uint8_t> error(7, 0);
+	error[1] = Wiegand::Error;
+	records = linkRecords(output.bytes);
+	CHECK(records.size() == 1 && records[0] == error && output.bytes.size() == 7 + 2 + 2);
+	CHECK(output.bytes[0] == 1 && output.bytes[1] == 2 && output.bytes[2] == Wiegand::Error);
+	CHECK(!link.send(0, Wiegand::Done, WIEGAND_MAX_BITS + 1, message.rcv_buffer, 0));
+
+	// without room records wait in buffer, record which doesn't fit is dropped
+	output.bytes.clear();
+	output.room = 0;
+	uint8_t sent = 0;
+	while (link.send(sent, Wiegand::Done, 26, message.rcv_buffer, sent))
+		sent++;
+	CHECK(sent == WIEGAND_LINK_BUFFER / 15 && link.dropped() == 1 && output.bytes.empty());
+
+	// update writes only what output takes, without blocking
+	output.room = 20;
+	link.update();
+	CHECK(output.bytes.size() == 20);
+	link.update();
+	CHECK(output.bytes.size() == 20);
+	output.room = 1000;
+	link.update();
+	CHECK(output.bytes.size() == sent * 15U);
+
+	// records taken across the end of buffer are in order and intact
+	for (uint8_t bus = 0; bus < 3; bus++)
+		CHECK(link.send(sent + bus, Wiegand::Done, 26, message.rcv_buffer, sent + bus));
+	records = linkRecords(output.bytes);
+	CHECK(records.size() == sent + 3U);
+	for (uint8_t i = 0; i < records.size(); i++)
+		CHECK(records[i] == linkRecord(i, h10301(1, 2), i));
+	CHECK(link.dropped() == 1 && !output.blocked);
+}
+
+WIEGAND_OUT_ISR()
+
+// level change of WiegandOut lines, time in microseconds since send
+struct OutEdge
+{
+	unsigned long time;
+	bool data0;
+	bool data1;
+};
+
+// calls Timer2 compare ISR until WiegandOut stops the timer, each call after OCR2A + 1 ticks
+static std::vector<OutEdge> runOut(const uint8_t data0_pin, const uint8_t data1_pin)
+{
+	std::vector<OutEdge> edges;
+	unsigned long ticks = 0;
+	bool data0 = true;
+	bool data1 = true;
+	while ((TIMSK2 & _BV(OCIE2A)) && ticks < 1000000UL)
+	{
+		ticks += OCR2A + 1;
+		TIMER2_COMPA_vect();
+		OutEdge edge;
+		edge.time = ticks * 64000UL / (F_CPU / 1000);
+		edge.data0 = output_ports[data0_pin >> 3] & (1 << (data0_pin & 7));
+		edge.data1 = output_ports[data1_pin >> 3] & (1 << (data1_pin & 7));
+		if (edge.data0 != data0 || edge.data1 != data1)
+			edges.push_back(edge);
+		data0 = edge.data0;
+		data1 = edge.data1;
+	}
+	return edges;
+}
+
+static void testOut()
+{
+	// pins only select bits of output ports, they aren't simulated lines
+	const uint8_t data0_pin = 60;
+	const uint8_t data1_pin = 61;
+	WiegandOut out(data0_pin, data1_pin);
+	CHECK(!out.send((const uint8_t *)"", 1));
+	CHECK(out.begin());
+	CHECK((output_ports[7] & 0x30) == 0x30 && !(TIMSK2 & _BV(OCIE2A)));
+
+	uint8_t buffer[WIEGAND_MAX_BYTES] = {};
+	for (uint8_t i = 0; i < 4; i++)
+		buffer[i] = h10301(1, 2) >> (i * 8);
+	CHECK(!out.send(buffer, 0) && !out.send(buffer, WIEGAND_MAX_BITS + 1));
+	CHECK(out.send(buffer, 26) && out.send(buffer, 26) && out.pending() == 2);
+	std::vector<OutEdge> edges = runOut(data0_pin, data1_pin);
+	CHECK(out.pending() == 0 && (output_ports[7] & 0x30) == 0x30);
+
+	// every bit is a pulse on one line, first bit of message first, Timer2 ticks are 4us
+	CHECK(edges.size() == 2 * 2 * 26U);
+	if (edges.size() != 2 * 2 * 26U)
+		return;
+	for (uint8_t message = 0; message < 2; message++)
+	{
+		uint64_t value = 0;
+		for (uint8_t bit = 0; bit < 26; bit++)
+		{
+			const OutEdge & start = edges[(message * 26 + bit) * 2];
+			const OutEdge & end = edges[(message * 26 + bit) * 2 + 1];
+			CHECK(start.data0 != start.data1 && end.data0 && end.data1);
+			value = value << 1 | !start.data1;
+			unsigned long width = end.time - start.time;
+			CHECK(width <= WIEGAND_OUT_PULSE_WIDTH && width + 4 >= WIEGAND_OUT_PULSE_WIDTH);
+			if (bit == 0)
+				continue;
+			unsigned long interval = start.time - edges[(message * 26 + bit - 1) * 2].time;
+			CHECK(interval <= WIEGAND_OUT_BIT_INTERVAL && interval + 8 >= WIEGAND_OUT_BIT_INTERVAL);
+		}
+		CHECK(value == h10301(1, 2));
+	}
+
+	// messages are apart by at least the gap
+	CHECK(edges[2 * 26].time - edges[2 * 26 - 1].time + 4 >= WIEGAND_OUT_MESSAGE_GAP);
+}
+
+static void testBeginFailure()
+{
+	// second pin is taken by rx, so begin fails and gives the first one back
+	uint8_t low_pin = next_pin;
+	Wiegand failed(low_pin, data1);
+	CHECK(!failed.begin());
+	CHECK(failed.status == Wiegand::Uninitialized);
+
+	WiegandSim::send(low_pin, low_pin, 0x3FF, 10);
+	WiegandSim::run(poll, 1000);
+	CHECK(failed.status == Wiegand::Uninitialized && received.empty());
+
+	uint8_t other_data0;
+	uint8_t other_data1;
+	Wiegand * other = newReceiver(other_data0, other_data1);
+	CHECK(other != NULL && other_data0 == low_pin);
+	if (other == NULL)
+		return;
+
+	WiegandSim::send(other_data0, other_data1, h10301(5, 5), 26);
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+	WiegandMessage message;
+	CHECK(other->read(message) && WiegandFrame(message).toUint64() == h10301(5, 5));
+}
+
+static void testCapacity()
+{
+	// receiver of 26 bit messages, with smaller buffers than rx
+	uint8_t low_pin = next_pin;
+	uint8_t high_pin = next_pin + 1;
+	next_pin += 2;
+	WiegandT<26> * small = new WiegandT<26>(low_pin, high_pin);
+	CHECK(small->begin() && small->maxBits() == 26);
+
+	// longer message is an error, queued messages keep their bits
+	WiegandSim::send(low_pin, high_pin, 0, 27);
+	for (uint8_t i = 0; i < WIEGAND_QUEUE_SIZE; i++)
+		WiegandSim::send(low_pin, high_pin, h10301(6, i), 26, WiegandTiming(50, 2000, 0, NEXT));
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+
+	WiegandMessage message;
+	memset(&message, 0xFF, sizeof(message));
+	for (uint8_t i = 0; i < WIEGAND_QUEUE_SIZE; i++)
+	{
+		CHECK(small->read(message) && WiegandFrame(message).toUint64() == h10301(6, i));
+		for (uint8_t byte = 4; byte < WIEGAND_MAX_BYTES; byte++)
+			CHECK(message.rcv_buffer[byte] == 0);
+	}
+	CHECK(!small->read(message));
+	CHECK(!small->finishRead() && small->status == Wiegand::Error);
+	small->clear();
+
+	WiegandSim::send(low_pin, high_pin, h10301(6, 9), 26);
+	WiegandSim::run(WiegandSim::end() + NEXT, noPoll, 0);
+	CHECK(small->finishRead() && small->bit_count == 26 && small->frame().toUint64() == h10301(6, 9));
+}
+
+static void testTimer1Epoch()
+{
+#if defined(WIEGAND_TIMER1_TIMESTAMPS)
+	// card is taken by poll after it timed out, its last edge is 1000us into a Timer1 period
+	const uint64_t period = 65536 / (F_CPU / 8000000UL);
+	uint64_t first = ((WiegandSim::now() + 100000) / period + 2) * period + 1000 - 25 * 2000;
+	WiegandSim::send(data0, data1, h10301(8, 1), 26, WiegandTiming(50, 2000, 0, first - WiegandSim::end()));
+	uint64_t last = first + 25 * 2000;
+	WiegandSim::run(WiegandSim::end() + NEXT, poll, 1000);
+	CHECK(received.size() == 1 && isCard(received[0], 8, 1));
+
+	// other bus takes 256 overflows meanwhile, so shared epoch comes back to the same value and
+	// next card starts with overflow flag clear and count 1000us past the count of last edge
+	uint8_t other_data0;
+	uint8_t other_data1;
+	CHECK(newReceiver(other_data0, other_data1) != NULL);
+	for (uint64_t i = 1; i <= 256; i++)
+		WiegandSim::pulse(other_data0, (last / period + i) * period + 100, 50);
+	uint64_t next = (last / period + 256) * period + 2000;
+	WiegandSim::send(data0, data1, h10301(8, 2), 26, WiegandTiming(50, 2000, 0, next - WiegandSim::end()));
+	WiegandSim::run(poll, 1000);
+
+	CHECK(errors == 0);
+	CHECK(received.size() == 2 && isCard(received[1], 8, 2));
+#endif
+}
+
+static void testMinBitInterval()
+{
+#if defined(WIEGAND_MIN_BIT_INTERVAL)
+	// spike shortly after every tenth bit is rejected
+	WiegandSim::send(data0, data1, h10301(6, 6), 26);
+	uint64_t first = WiegandSim::end() - 25 * 2000 - 50;
+	for (uint8_t i = 0; i < 26; i += 10)
+		WiegandSim::pulse(data1, first + i * 2000 + WIEGAND_MIN_BIT_INTERVAL / 2 + 10, 5);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 1 && isCard(received[0], 6, 6));
+#if defined(WIEGAND_STATS)
+	WiegandStats stats;
+	rx->getStats(stats);
+	CHECK(stats.glitches == 3);
+#endif
+#endif
+}
+
+static void testMinPulseWidth()
+{
+#if defined(WIEGAND_MIN_PULSE_WIDTH)
+	uint64_t first;
+#if WIEGAND_MIN_PULSE_WIDTH > 1
+	// spike shorter than minimum width between bits is rejected
+	WiegandSim::send(data0, data1, h10301(7, 7), 26);
+	first = WiegandSim::end() - 25 * 2000 - 50;
+	WiegandSim::pulse(data0, first + 1000, WIEGAND_MIN_PULSE_WIDTH / 2);
+	WiegandSim::run(poll, 1000);
+	CHECK(received.size() == 1 && isCard(received[0], 7, 7));
+#endif
+
+	// pulse on the other line overlaps a bit (a zero), so it can't be told and message is dropped
+	WiegandSim::send(data0, data1, h10301(7, 8), 26, WiegandTiming(300));
+	first = WiegandSim::end() - 25 * 2000 - 300;
+	WiegandSim::pulse(data1, first + 10 * 2000 + 150, SHORT_PULSE);
+	WiegandSim::run(poll, 1000);
+	CHECK(received.size() == (WIEGAND_MIN_PULSE_WIDTH > 1 ? 1U : 0U));
+
+#if defined(WIEGAND_STATS)
+	WiegandStats stats;
+	rx->getStats(stats);
+	CHECK(stats.glitches == (WIEGAND_MIN_PULSE_WIDTH > 1 ? 1 : 0) && stats.collisions == 1);
+#endif
+#endif
+}
+
+static void testAdaptiveTimeout()
+{
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	// once interval is learned, messages only a few intervals apart are told apart
+	WiegandTiming close(50, 1000, 0, (WIEGAND_ADAPTIVE_TIMEOUT + 1) * 1000);
+	for (uint8_t i = 0; i < 4; i++)
+		WiegandSim::send(data0, data1, h10301(8, i), 26, close);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 4);
+	for (uint8_t i = 0; i < received.size(); i++)
+		CHECK(isCard(received[i], 8, i));
+#endif
+}
+
+static void testAdaptiveBounce()
+{
+#if defined(WIEGAND_ADAPTIVE_TIMEOUT)
+	// bounce as the first interval ever seen doesn't shrink the timeout below real bit interval
+	WiegandSim::pulse(data1, WiegandSim::now() + 1000, 10);
+	WiegandSim::pulse(data1, WiegandSim::now() + 1030, 10);
+	for (uint8_t i = 0; i < 3; i++)
+		WiegandSim::send(data0, data1, h10301(8, i), 26);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 4 && received[0].bits < 26);
+	for (uint8_t i = 1; i < received.size(); i++)
+		CHECK(isCard(received[i], 8, i - 1));
+#endif
+}
+
+static void testRepeatWindow()
+{
+#if defined(WIEGAND_REPEAT_WINDOW)
+	// same card three times within the window is reported once, again after the window
+	for (uint8_t i = 0; i < 3; i++)
+		WiegandSim::send(data0, data1, h10301(9, 9), 26);
+	WiegandSim::run(poll, 1000);
+	WiegandSim::send(data0, data1, h10301(9, 9), 26, WiegandTiming(50, 2000, 0, WIEGAND_REPEAT_WINDOW * 1000UL + 1000));
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 2);
+
+	// the same key pressed again is not a repeat
+	for (uint8_t i = 0; i < 3; i++)
+		WiegandSim::send(data0, data1, 5, 4);
+	for (uint8_t i = 0; i < 3; i++)
+		WiegandSim::send(data0, data1, 0xA5, 8);
+	WiegandSim::run(poll, 1000);
+
+	CHECK(received.size() == 8);
+#endif
+}
+
+static void testCapture()
+{
+#if defined(WIEGAND_CAPTURE)
+	WiegandSim::send(data0, data1, h10301(1, 2), 26);
+	uint64_t first = WiegandSim::end() - 25 * 2000 - 50;
+	WiegandSim::run(poll, 1000);
+
+	// with WIEGAND_TIMER1_TIMESTAMPS the first edge reads micros() after Timer1, and every read in
+	// ISR takes a microsecond of simulated time, so intervals are exact but the start may be late
+	WiegandEdge edge;
+	uint8_t count = 0;
+	uint32_t start = 0;
+	while (rx->readEdge(edge))
+	{
+		if (count == 0)
+			start = edge.micros;
+		CHECK(edge.micros == start + count * 2000);
+		CHECK(edge.line == ((h10301(1, 2) >> (25 - count)) & 1));
+		count++;
+	}
+	CHECK(start - (uint32_t)first <= 2);
+	CHECK(count == (26 < WIEGAND_CAPTURE ? 26 : WIEGAND_CAPTURE));
+#endif
+}
+
+struct Test
+{
+	const char * name;
+	void (*run)();
+};
+
+static const Test tests[] =
+{
+	{"decode", testDecode},
+	{"lengths", testLengths},
+	{"parity", testParity},
+	{"formats", testFormats},
+	{"pulse width and jitter", testPulseWidthAndJitter},
+	{"back to back", testBackToBack},
+	{"queue overflow", testQueueOverflow},
+	{"micros wrap", testMicrosWrap},
+	{"too long", testTooLong},
+	{"edge during poll", testEdgeDuringPoll},
+	{"interrupts disabled", testInterruptsDisabled},
+	{"suspend", testSuspend},
+	{"read api", testReadApi},
+	{"dispatch", testDispatch},
+	{"hub", testHub},
+	{"keypad", testKeypad},
+	{"begin failure", testBeginFailure},
+	{"capacity", testCapacity},
+	{"timer1 epoch", testTimer1Epoch},
+	{"min bit interval", testMinBitInterval},
+	{"min pulse width", testMinPulseWidth},
+	{"adaptive timeout", testAdaptiveTimeout},
+	{"adaptive bounce", testAdaptiveBounce},
+	{"repeat window", testRepeatWindow},
+	{"capture", testCapture},
+};
+
+// tests of classes which don't need a receiver, they get no rx, so they don't use up pins
+static const Test other_tests[] =
+{
+	{"access search", testAccessSearch},
+	{"access journal", testAccessJournal},
+	{"access compaction", testAccessCompaction},
+	{"access full", testAccessFull},
+	{"access bloom", testAccessBloom},
+	{"link", testLink},
+	{"out", testOut},
+};
+
+// runs one test, with a new rx on its own pins if receiver is true
+// returns false if the test failed
+static bool run(const Test & test, const unsigned int seed, const bool receiver)
+{
+	current_test = test.name;
+	current_failed = false;
+	received.clear();
+	errors = 0;
+
+	WiegandSim::reset(1000000, seed);
+	rx = NULL;
+	if (receiver)
+	{
+		rx = newReceiver(data0, data1);
+		if (rx == NULL)
+		{
+			printf("%s: begin failed\n", current_test);
+			return false;
+		}
+	}
+
+	test.run();
+	printf("%-24s %s\n", current_test, current_failed ? "FAILED" : "ok");
+	return !current_failed;
+}
+
+int main()
+{
+	unsigned int failed = 0;
+	unsigned int count = 0;
+	for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+	{
+		if (!run(tests[i], ++count, true))
+			failed++;
+	}
+	for (size_t i = 0; i < sizeof(other_tests) / sizeof(other_tests[0]); i++)
+	{
+		if (!run(other_tests[i], ++count, false))
+			failed++;
+	}
+
+	printf("%u of %u tests failed\n", failed, count);
+	return failed ? 1 : 0;
+}
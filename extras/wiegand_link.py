@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+#
+# Wiegand protocol library for Arduino.
+# Copyright (c) 2014 and IN2 Arduino Grupa <in2.arguino@gmail.com>
+#
+# This library is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+#
+# Host side decoder of records sent by WiegandLink, see WiegandLink.h for record format.
+#
+# As a library:
+#     decoder = WiegandLinkDecoder()
+#     for record in decoder.feed(data):
+#         print(record.bus, record.bit_count, hex(record.value))
+#
+# From command line, reads a serial port (needs pyserial) or stdin and prints one line per record:
+#     python3 wiegand_link.py /dev/ttyUSB0 115200
+#
+
+import collections
+import struct
+import sys
+
+# Wiegand::WiegandStatus values
+STATUS_NAMES = ('Uninitialized', 'Idle', 'Receiving', 'Done', 'Error')
+
+WiegandRecord = collections.namedtuple('WiegandRecord',
+    'bus status bit_count payload duration value')
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, same as WiegandLink::crc"""
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    """decodes COBS frame without delimiter, returns None if it is malformed"""
+    out = bytearray()
+    pos = 0
+    while pos < len(frame):
+        code = frame[pos]
+        if code == 0 or pos + code > len(frame):
+            return None
+        out += frame[pos + 1:pos + code]
+        pos += code
+        if code < 0xFF and pos < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_record(data):
+    """parses decoded record, returns WiegandRecord or None if it is corrupted"""
+    if len(data) < 9 or crc16(data[:-2]) != struct.unpack_from('<H', data, len(data) - 2)[0]:
+        return None
+    bus, status, bit_count = data[0], data[1], data[2]
+    size = (bit_count + 7) // 8
+    if len(data) != 3 + size + 4 + 2:
+        return None
+    payload = data[3:3 + size]
+    duration = struct.unpack_from('<I', data, 3 + size)[0]
+    # last bit is in LSB of first byte, so payload is a little endian integer
+    value = int.from_bytes(payload, 'little')
+    return WiegandRecord(bus, status, bit_count, payload, duration, value)
+
+
+class WiegandLinkDecoder(object):
+    """splits byte stream into records, corrupted records are counted and skipped"""
+
+    def __init__(self):
+        self._frame = bytearray()
+        self.errors = 0
+
+    def feed(self, data):
+        """returns list of records completed by data"""
+        records = []
+        data = bytes(data)
+        start = 0
+        while True:
+            end = data.find(b'\x00', start)
+            if end < 0:
+                self._frame += data[start:]
+                return records
+            self._frame += data[start:end]
+            start = end + 1
+            if self._frame:
+                decoded = cobs_decode(bytes(self._frame))
+                record = parse_record(decoded) if decoded is not None else None
+                if record is None:
+                    self.errors += 1
+                else:
+                    records.append(record)
+            self._frame = bytearray()
+
+
+def main(argv):
+    if len(argv) > 1:
+        import serial
+        port = serial.Serial(argv[1], int(argv[2]) if len(argv) > 2 else 115200, timeout=0.1)
+        read = lambda: port.read(port.in_waiting or 1)
+    else:
+        stdin = sys.stdin.buffer
+        read = lambda: stdin.read1(4096) if hasattr(stdin, 'read1') else stdin.read(1)
+
+    decoder = WiegandLinkDecoder()
+    while True:
+        data = read()
+        if not data and len(argv) <= 1:
+            break
+        for record in decoder.feed(data):
+            status = STATUS_NAMES[record.status] if record.status < len(STATUS_NAMES) else record.status
+            print('bus %d %s %d bits %x in %dus' % (record.bus, status, record.bit_count,
+                record.value, record.duration))
+        sys.stdout.flush()
+    if decoder.errors:
+        print('%d corrupted records' % decoder.errors, file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main(sys.argv)